@@ -0,0 +1,818 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "vector.h"
+#include "smallvector.h"
+#include "queue.h"
+#include "mpmcqueue.h"
+#include "spscqueue.h"
+#include "lockfreequeue.h"
+#include "twolockqueue.h"
+#include "stack.h"
+#include "lockfreestack.h"
+#include "workstealingdeque.h"
+#include "doublylinkedlist.h"
+#include "concurrentvector.h"
+#include "parallel.h"
+
+using Clock = std::chrono::steady_clock;
+
+void bench_vector_readers();
+void bench_concurrent_append();
+void bench_vector_scan();
+void bench_parallel_sort();
+void bench_queue_pool();
+void bench_list_compact();
+void bench_small_vector();
+void bench_stack_contention();
+void bench_stack_push_latency();
+void bench_work_stealing();
+void bench_mpmc_handoff();
+void bench_spsc_pipeline();
+void bench_queue_lockfree();
+void bench_queue_two_lock();
+void bench_queue_wait_pop();
+
+void run(int argc, char** argv, const char* name, void (*bench)())
+{
+    if (argc > 1 && std::strcmp(argv[1], name) != 0)
+        return;
+
+    std::cout << "\n---------------------------------\n" << name << '\n';
+    bench();
+    std::cout << "---------------------------------\n";
+}
+
+int main(int argc, char** argv)
+{
+    run(argc, argv, "vector_readers", bench_vector_readers);
+    run(argc, argv, "concurrent_append", bench_concurrent_append);
+    run(argc, argv, "vector_scan", bench_vector_scan);
+    run(argc, argv, "parallel_sort", bench_parallel_sort);
+    run(argc, argv, "queue_pool", bench_queue_pool);
+    run(argc, argv, "list_compact", bench_list_compact);
+    run(argc, argv, "small_vector", bench_small_vector);
+    run(argc, argv, "stack_contention", bench_stack_contention);
+    run(argc, argv, "stack_push_latency", bench_stack_push_latency);
+    run(argc, argv, "work_stealing", bench_work_stealing);
+    run(argc, argv, "mpmc_handoff", bench_mpmc_handoff);
+    run(argc, argv, "spsc_pipeline", bench_spsc_pipeline);
+    run(argc, argv, "queue_lockfree", bench_queue_lockfree);
+    run(argc, argv, "queue_two_lock", bench_queue_two_lock);
+    run(argc, argv, "queue_wait_pop", bench_queue_wait_pop);
+
+    return 0;
+}
+
+template <typename Lock>
+double vector_reader_throughput(int readers)
+{
+    const int length = 1 << 20;
+
+    Vector<int, Lock> vec(length);
+    for (int i = 0; i < length; i++)
+        vec.push_back(i);
+
+    std::atomic<bool>      running(true);
+    std::atomic<long long> reads(0);
+    std::vector<std::thread> threads;
+
+    threads.emplace_back([&]()
+    {
+        for (int i = 0; running.load(std::memory_order_relaxed); i++)
+        {
+            vec.push_back(i);
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+
+    for (int r = 0; r < readers; r++)
+    {
+        threads.emplace_back([&, r]()
+        {
+            long long count = 0;
+            long long sum = 0;
+
+            for (int i = r; running.load(std::memory_order_relaxed); i += 7919)
+            {
+                sum += vec.at(i & (length - 1));
+                count++;
+            }
+
+            reads += count + (sum == -1);
+        });
+    }
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    running = false;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return reads / seconds / 1e6;
+}
+
+// One writer appending every 50us while N readers call at().
+void bench_vector_readers()
+{
+    std::cout << std::setw(8) << "readers" << std::setw(14) << "MutexLock" << std::setw(18) << "SharedMutexLock" << "  (Mreads/s)\n";
+
+    for (int readers = 1; readers <= 16; readers *= 2)
+    {
+        std::cout << std::setw(8) << readers
+                  << std::setw(14) << std::fixed << std::setprecision(2) << vector_reader_throughput<MutexLock>(readers)
+                  << std::setw(18) << vector_reader_throughput<SharedMutexLock>(readers) << '\n';
+    }
+}
+
+template <typename Container>
+double append_throughput(Container& container, int writers, int per_writer)
+{
+    std::vector<std::thread> threads;
+
+    auto start = Clock::now();
+
+    for (int w = 0; w < writers; w++)
+    {
+        threads.emplace_back([&container, per_writer]()
+        {
+            for (int i = 0; i < per_writer; i++)
+                container.push_back(i);
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return writers * static_cast<double>(per_writer) / seconds / 1e6;
+}
+
+// N threads appending 4M ints in total.
+void bench_concurrent_append()
+{
+    const int total = 1 << 22;
+
+    std::cout << std::setw(8) << "writers" << std::setw(18) << "Vector<MutexLock>" << std::setw(18) << "ConcurrentVector" << "  (Mappends/s)\n";
+
+    for (int writers = 1; writers <= 32; writers *= 2)
+    {
+        Vector<int, MutexLock> locked;
+        ConcurrentVector<int>  concurrent;
+
+        std::cout << std::setw(8) << writers
+                  << std::setw(18) << std::fixed << std::setprecision(2) << append_throughput(locked, writers, total / writers)
+                  << std::setw(18) << append_throughput(concurrent, writers, total / writers) << '\n';
+    }
+}
+
+template <typename Function>
+double time_ms(Function function)
+{
+    auto start = Clock::now();
+    function();
+
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Scans of a 16M element column: at() per element versus the bulk kernels.
+void bench_vector_scan()
+{
+    const int length = 1 << 24;
+
+    Vector<int, MutexLock>    ints(length);
+    Vector<double, MutexLock> doubles(length);
+    for (int i = 0; i < length; i++)
+    {
+        ints.push_back(i % 1000);
+        doubles.push_back(i % 1000);
+    }
+
+    volatile long long sink = 0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "simd level: " << static_cast<int>(simd::level()) << '\n';
+    std::cout << "int sum, at() loop:      " << time_ms([&]() { long long s = 0; for (int i = 0; i < length; i++) s += ints.at(i); sink = s; }) << " ms\n";
+    std::cout << "int sum, scalar kernel:  " << time_ms([&]() { sink = simd::scalar::sum(&ints[0], length); }) << " ms\n";
+    std::cout << "int sum():               " << time_ms([&]() { sink = ints.sum(); }) << " ms\n";
+    std::cout << "int max():               " << time_ms([&]() { sink = ints.max(); }) << " ms\n";
+    std::cout << "int count():             " << time_ms([&]() { sink = ints.count(7); }) << " ms\n";
+    std::cout << "int find() (absent):     " << time_ms([&]() { sink = ints.find(-1); }) << " ms\n";
+    std::cout << "double sum, scalar:      " << time_ms([&]() { sink = static_cast<long long>(simd::scalar::sum(&doubles[0], length)); }) << " ms\n";
+    std::cout << "double sum():            " << time_ms([&]() { sink = static_cast<long long>(doubles.sum()); }) << " ms\n";
+    std::cout << "double fill():           " << time_ms([&]() { doubles.fill(1.5); }) << " ms\n";
+}
+
+// Sorting 16M random ints with std::sort versus parallel_sort on pools of
+// increasing size.
+void bench_parallel_sort()
+{
+    const int length = 1 << 24;
+
+    std::vector<int> source(length);
+    std::mt19937 generator(42);
+    for (int& value : source)
+        value = static_cast<int>(generator());
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    {
+        Vector<int, NoLock> vec(length);
+        vec.append(source.data(), source.data() + length);
+
+        std::cout << std::setw(8) << "std::sort" << std::setw(12)
+                  << time_ms([&]() { vec.access([](int* data, size_t n) { std::sort(data, data + n); }); }) << " ms\n";
+    }
+
+    for (size_t threads = 1; threads <= 16; threads *= 2)
+    {
+        ThreadPool pool(threads);
+        Vector<int, NoLock> vec(length);
+        vec.append(source.data(), source.data() + length);
+
+        std::cout << std::setw(6) << threads << " threads" << std::setw(10)
+                  << time_ms([&]() { parallel_sort(vec, pool); }) << " ms\n";
+    }
+}
+
+enum class NodeRecycling { Off, Pool, PoolAndThreadCache };
+
+double queue_round_trips(int threads, NodeRecycling recycling)
+{
+    const int per_thread = 1 << 20;
+    const int burst = 32;
+
+    Queue<int, MutexLock> queue;
+    if (recycling != NodeRecycling::Off)
+        queue.reserve_nodes(threads * burst);
+    if (recycling == NodeRecycling::PoolAndThreadCache)
+        queue.set_thread_cache(true);
+
+    std::vector<std::thread> workers;
+
+    auto start = Clock::now();
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&queue]()
+        {
+            for (int i = 0; i < per_thread; i += burst)
+            {
+                for (int j = 0; j < burst; j++)
+                    queue.push(j);
+                for (int j = 0; j < burst; j++)
+                    queue.pop();
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return threads * static_cast<double>(per_thread) / seconds / 1e6;
+}
+
+// N threads pushing and popping bursts of 32 on one Queue, with and without
+// node recycling.
+void bench_queue_pool()
+{
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "new/delete" << std::setw(10) << "pool" << std::setw(16) << "pool+cache" << "  (Mround trips/s)\n";
+
+    for (int threads = 1; threads <= 8; threads *= 2)
+    {
+        std::cout << std::setw(8) << threads
+                  << std::setw(12) << std::fixed << std::setprecision(2) << queue_round_trips(threads, NodeRecycling::Off)
+                  << std::setw(10) << queue_round_trips(threads, NodeRecycling::Pool)
+                  << std::setw(16) << queue_round_trips(threads, NodeRecycling::PoolAndThreadCache) << '\n';
+    }
+}
+
+// Traversal of a 10M node list whose nodes are scattered across the heap,
+// before and after compact(). The scattering comes from moving nodes one at
+// a time out of many randomly chosen lists: each pop frees a node and the
+// following push reuses that address, so list order ends up unrelated to
+// address order.
+void bench_list_compact()
+{
+    const int length = 10000000;
+    const int buckets = 4096;
+
+    std::mt19937 generator(42);
+
+    DoublyLinkedList<long long, NoLock> list;
+
+    {
+        std::vector<DoublyLinkedList<long long, NoLock>> scattered(buckets);
+        for (int i = 0; i < length; i++)
+            scattered[generator() % buckets].push_back(i);
+
+        std::vector<int> remaining;
+        for (int b = 0; b < buckets; b++)
+        {
+            if (scattered[b].get_length())
+                remaining.push_back(b);
+        }
+
+        while (!remaining.empty())
+        {
+            size_t pick = generator() % remaining.size();
+            auto&  source = scattered[remaining[pick]];
+
+            list.push_back(source.pop_front());
+
+            if (!source.get_length())
+            {
+                remaining[pick] = remaining.back();
+                remaining.pop_back();
+            }
+        }
+    }
+
+    volatile long long sink = 0;
+    auto traverse = [&]() { long long sum = 0; list.for_each([&](long long value) { sum += value; }); sink = sum; };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "fragmented traversal:  " << time_ms(traverse) << " ms\n";
+    std::cout << "compact():             " << time_ms([&]() { list.compact(); }) << " ms\n";
+    std::cout << "compacted traversal:   " << time_ms(traverse) << " ms\n";
+}
+
+// Building and dropping 1M vectors of 12 ints, the common case for our
+// short-lived vectors.
+void bench_small_vector()
+{
+    const int rounds = 1000000;
+    const int length = 12;
+
+    volatile long long sink = 0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Vector<int, NoLock>:          " << time_ms([&]()
+    {
+        for (int r = 0; r < rounds; r++)
+        {
+            Vector<int, NoLock> vec(length);
+            for (int i = 0; i < length; i++)
+                vec.push_back(i);
+            sink = sink + vec.at(r % length);
+        }
+    }) << " ms\n";
+    std::cout << "SmallVector<int, 16, NoLock>: " << time_ms([&]()
+    {
+        for (int r = 0; r < rounds; r++)
+        {
+            SmallVector<int, 16, NoLock> vec;
+            for (int i = 0; i < length; i++)
+                vec.push_back(i);
+            sink = sink + vec.at(r % length);
+        }
+    }) << " ms\n";
+}
+
+template <typename Stack>
+double stack_pair_throughput(Stack& stack, int threads, int per_thread)
+{
+    std::vector<std::thread> workers;
+
+    auto start = Clock::now();
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&stack, per_thread]()
+        {
+            for (int i = 0; i < per_thread; i++)
+            {
+                stack.push(i);
+                stack.pop();
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return threads * static_cast<double>(per_thread) / seconds / 1e6;
+}
+
+// N threads each doing push/pop pairs on one shared stack, 2M pairs in total;
+// the last column adds an 8-slot elimination array.
+void bench_stack_contention()
+{
+    const int total = 1 << 21;
+
+    std::cout << std::setw(8) << "threads" << std::setw(18) << "Stack<MutexLock>" << std::setw(16) << "LockFreeStack" << std::setw(14) << "+elimination" << "  (Mpairs/s)\n";
+
+    for (int threads = 1; threads <= 64; threads *= 2)
+    {
+        Stack<int, MutexLock> locked(threads + 2);
+        LockFreeStack<int>    lock_free;
+        LockFreeStack<int>    eliminating(8);
+
+        std::cout << std::setw(8) << threads
+                  << std::setw(18) << std::fixed << std::setprecision(2) << stack_pair_throughput(locked, threads, total / threads)
+                  << std::setw(16) << stack_pair_throughput(lock_free, threads, total / threads)
+                  << std::setw(14) << stack_pair_throughput(eliminating, threads, total / threads) << '\n';
+    }
+}
+
+template <typename Stack>
+void stack_push_latency(const char* name, Stack& stack, int count)
+{
+    double worst = 0;
+
+    auto start = Clock::now();
+
+    for (int i = 0; i < count; i++)
+    {
+        auto before = Clock::now();
+        stack.push(i);
+        worst = std::max(worst, std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+    }
+
+    double total = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << name << std::fixed << std::setprecision(2) << std::setw(10) << total << " ms total, worst push " << worst << " us\n";
+}
+
+// 16M pushes onto a stack that starts small: geometric growth copies the
+// whole stack on every doubling, chunked growth only links a new chunk.
+void bench_stack_push_latency()
+{
+    const int count = 1 << 24;
+
+    {
+        Stack<int, NoLock> stack(16, StackOverflow::Grow);
+        stack_push_latency("Grow:                ", stack, count);
+    }
+    {
+        Stack<int, NoLock> stack(4096, StackOverflow::GrowChunked);
+        stack_push_latency("GrowChunked (4096):  ", stack, count);
+    }
+}
+
+// The owner pushes tasks and pops them back while thieves take from the same
+// container until every task has run once. Push, pop and steal are passed in
+// so the locked Stack and the deque share the driver.
+template <typename Push, typename Pop, typename Steal>
+double stealing_throughput(int thieves, int tasks, Push push, Pop pop, Steal steal)
+{
+    std::atomic<int>  done(0);
+    std::vector<std::thread> workers;
+
+    auto start = Clock::now();
+
+    for (int t = 0; t < thieves; t++)
+    {
+        workers.emplace_back([&]()
+        {
+            int task;
+            while (done.load(std::memory_order_relaxed) < tasks)
+            {
+                if (steal(task))
+                    done.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    int task;
+    for (int i = 0; i < tasks; i++)
+    {
+        push(i);
+
+        if (i % 4 == 3)
+        {
+            while (pop(task))
+                done.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    while (done.load(std::memory_order_relaxed) < tasks)
+    {
+        if (pop(task))
+            done.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return tasks / seconds / 1e6;
+}
+
+// One owner running 4M tasks with 0 to 3 thieves stealing from it.
+void bench_work_stealing()
+{
+    const int tasks = 1 << 22;
+
+    std::cout << std::setw(8) << "thieves" << std::setw(18) << "Stack<MutexLock>" << std::setw(20) << "WorkStealingDeque" << "  (Mtasks/s)\n";
+
+    for (int thieves = 0; thieves <= 3; thieves++)
+    {
+        Stack<int, MutexLock>  locked(64);
+        WorkStealingDeque<int> deque;
+
+        auto locked_pop = [&](int& task)
+        {
+            std::optional<int> popped = locked.try_pop();
+            if (popped)
+                task = *popped;
+
+            return popped.has_value();
+        };
+
+        std::cout << std::setw(8) << thieves
+                  << std::setw(18) << std::fixed << std::setprecision(2)
+                  << stealing_throughput(thieves, tasks, [&](int task) { locked.push(task); }, locked_pop, locked_pop)
+                  << std::setw(20)
+                  << stealing_throughput(thieves, tasks, [&](int task) { deque.push(task); },
+                                         [&](int& task) { return deque.try_pop(task); },
+                                         [&](int& task) { return deque.try_steal(task); }) << '\n';
+    }
+}
+
+// Producers hand messages over to consumers until every message has been
+// received. try_push and try_pop return false when full or empty, and the
+// caller yields before retrying.
+template <typename TryPush, typename TryPop>
+double handoff_throughput(int producers, int consumers, int messages, TryPush try_push, TryPop try_pop)
+{
+    std::atomic<int> received(0);
+    std::vector<std::thread> workers;
+
+    auto start = Clock::now();
+
+    for (int p = 0; p < producers; p++)
+    {
+        workers.emplace_back([&, p]()
+        {
+            for (int i = p; i < messages; i += producers)
+            {
+                while (!try_push(i))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for (int c = 0; c < consumers; c++)
+    {
+        workers.emplace_back([&]()
+        {
+            int message;
+            while (received.load(std::memory_order_relaxed) < messages)
+            {
+                if (try_pop(message))
+                    received.fetch_add(1, std::memory_order_relaxed);
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return messages / seconds / 1e6;
+}
+
+// 2M messages through Queue<MutexLock> and a 1024-slot MPMCQueue.
+void bench_mpmc_handoff()
+{
+    const int messages = 1 << 21;
+
+    std::cout << std::setw(14) << "prod x cons" << std::setw(18) << "Queue<MutexLock>" << std::setw(12) << "MPMCQueue" << "  (Mmsgs/s)\n";
+
+    for (int producers : { 1, 2, 4 })
+    {
+        for (int consumers : { 1, 2, 4 })
+        {
+            Queue<int, MutexLock> locked;
+            MPMCQueue<int>        ring(1024);
+
+            std::cout << std::setw(10) << producers << " x " << consumers
+                      << std::setw(18) << std::fixed << std::setprecision(2)
+                      << handoff_throughput(producers, consumers, messages,
+                                            [&](int message) { locked.push(message); return true; },
+                                            [&](int& message) { return locked.pop_bulk(&message, 1) == 1; })
+                      << std::setw(12)
+                      << handoff_throughput(producers, consumers, messages,
+                                            [&](int message) { return ring.try_push(message); },
+                                            [&](int& message) { return ring.try_pop(message); }) << '\n';
+        }
+    }
+}
+
+// One producer and one consumer moving batches of up to 64 messages.
+double spsc_bulk_throughput(SPSCQueue<int>& queue, int messages)
+{
+    const int batch = 64;
+
+    auto start = Clock::now();
+
+    std::thread producer([&]()
+    {
+        int values[batch];
+
+        for (int i = 0; i < messages; )
+        {
+            int count = std::min(batch, messages - i);
+            for (int j = 0; j < count; j++)
+                values[j] = i + j;
+
+            size_t pushed = queue.push_bulk(values, values + count);
+            if (!pushed)
+                std::this_thread::yield();
+
+            i += static_cast<int>(pushed);
+        }
+    });
+
+    long long sum = 0;
+    int values[batch];
+
+    for (int received = 0; received < messages; )
+    {
+        size_t popped = queue.pop_bulk(values, batch);
+        if (!popped)
+            std::this_thread::yield();
+
+        for (size_t j = 0; j < popped; j++)
+            sum += values[j];
+
+        received += static_cast<int>(popped);
+    }
+
+    producer.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return messages / seconds / 1e6 + (sum == -1);
+}
+
+// 16M messages from one producer thread to one consumer thread.
+void bench_spsc_pipeline()
+{
+    const int messages = 1 << 24;
+
+    Queue<int, MutexLock> locked;
+    MPMCQueue<int>        mpmc(4096);
+    SPSCQueue<int>        spsc(4096);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Queue<MutexLock>:     " << std::setw(8)
+              << handoff_throughput(1, 1, messages,
+                                    [&](int message) { locked.push(message); return true; },
+                                    [&](int& message) { return locked.pop_bulk(&message, 1) == 1; }) << " Mmsgs/s\n";
+    std::cout << "MPMCQueue:            " << std::setw(8)
+              << handoff_throughput(1, 1, messages,
+                                    [&](int message) { return mpmc.try_push(message); },
+                                    [&](int& message) { return mpmc.try_pop(message); }) << " Mmsgs/s\n";
+    std::cout << "SPSCQueue:            " << std::setw(8)
+              << handoff_throughput(1, 1, messages,
+                                    [&](int message) { return spsc.try_push(message); },
+                                    [&](int& message) { return spsc.try_pop(message); }) << " Mmsgs/s\n";
+    std::cout << "SPSCQueue, bulk of 64:" << std::setw(8) << spsc_bulk_throughput(spsc, messages) << " Mmsgs/s\n";
+}
+
+// 2M messages through the unbounded queues at varying producer and consumer
+// counts.
+void bench_queue_lockfree()
+{
+    const int messages = 1 << 21;
+
+    std::cout << std::setw(14) << "prod x cons" << std::setw(18) << "Queue<MutexLock>" << std::setw(16) << "LockFreeQueue" << "  (Mmsgs/s)\n";
+
+    for (int threads : { 1, 2, 4, 8 })
+    {
+        Queue<int, MutexLock> locked;
+        LockFreeQueue<int>    lock_free;
+
+        std::cout << std::setw(10) << threads << " x " << threads
+                  << std::setw(18) << std::fixed << std::setprecision(2)
+                  << handoff_throughput(threads, threads, messages,
+                                        [&](int message) { locked.push(message); return true; },
+                                        [&](int& message) { return locked.pop_bulk(&message, 1) == 1; })
+                  << std::setw(16)
+                  << handoff_throughput(threads, threads, messages,
+                                        [&](int message) { lock_free.push(message); return true; },
+                                        [&](int& message) { return lock_free.try_pop(message); }) << '\n';
+    }
+}
+
+// 2M messages through Queue and TwoLockQueue, both on std::mutex.
+void bench_queue_two_lock()
+{
+    const int messages = 1 << 21;
+
+    std::cout << std::setw(14) << "prod x cons" << std::setw(18) << "Queue<MutexLock>" << std::setw(14) << "TwoLockQueue" << "  (Mmsgs/s)\n";
+
+    for (int threads : { 1, 2, 4 })
+    {
+        Queue<int, MutexLock>        locked;
+        TwoLockQueue<int, MutexLock> two_lock;
+
+        std::cout << std::setw(10) << threads << " x " << threads
+                  << std::setw(18) << std::fixed << std::setprecision(2)
+                  << handoff_throughput(threads, threads, messages,
+                                        [&](int message) { locked.push(message); return true; },
+                                        [&](int& message) { return locked.pop_bulk(&message, 1) == 1; })
+                  << std::setw(14)
+                  << handoff_throughput(threads, threads, messages,
+                                        [&](int message) { two_lock.push(message); return true; },
+                                        [&](int& message) { return two_lock.try_pop(message); }) << '\n';
+    }
+}
+
+// A producer sends 200 bursts of 1000 messages, pausing 1ms between bursts,
+// while one consumer polls pop() and catches the empty case, polls
+// try_pop(), or blocks in wait_pop(). The CPU column is process CPU time, so it mostly
+// shows what the consumer burns while the producer sleeps.
+template <typename Consume>
+void queue_consumer_cost(const char* name, Queue<int, MutexLock>& queue, Consume consume)
+{
+    const int bursts = 200;
+    const int burst = 1000;
+
+    std::clock_t cpu_start = std::clock();
+    auto start = Clock::now();
+
+    std::thread consumer(consume);
+
+    for (int b = 0; b < bursts; b++)
+    {
+        for (int i = 0; i < burst; i++)
+            queue.push(i);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    queue.close();
+    consumer.join();
+
+    double wall = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    double cpu = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    std::cout << name << std::fixed << std::setprecision(2) << std::setw(10) << wall << " ms wall" << std::setw(10) << cpu << " ms CPU\n";
+}
+
+void bench_queue_wait_pop()
+{
+    const int messages = 200 * 1000;
+
+#ifndef DS_NO_EXCEPTIONS
+    {
+        Queue<int, MutexLock> queue;
+        queue_consumer_cost("pop() in try/catch: ", queue, [&]()
+        {
+            for (int received = 0; received < messages; )
+            {
+                try
+                {
+                    queue.pop();
+                    received++;
+                }
+                catch (const std::out_of_range&)
+                {
+                }
+            }
+        });
+    }
+#endif
+    {
+        Queue<int, MutexLock> queue;
+        queue_consumer_cost("try_pop() polling:  ", queue, [&]()
+        {
+            for (int received = 0; received < messages; )
+            {
+                if (queue.try_pop())
+                    received++;
+            }
+        });
+    }
+    {
+        Queue<int, MutexLock> queue;
+        queue_consumer_cost("wait_pop():         ", queue, [&]()
+        {
+            int message;
+            while (queue.wait_pop(message)) { }
+        });
+    }
+}
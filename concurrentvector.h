@@ -0,0 +1,324 @@
+#ifndef CONCURRENTVECTOR_H
+#define CONCURRENTVECTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "exceptions.h"
+
+// Append-only vector for many concurrent writers. Storage is a table of
+// power-of-two segments: push_back claims a slot with one fetch_add and
+// growth installs a new segment with a CAS, so existing elements never move
+// and references stay valid for the lifetime of the container. Readers never
+// lock.
+//
+// An index is counted in the length as soon as it is claimed. If building
+// the element (or allocating its segment) throws, the slot is marked failed
+// rather than left pending, and at and try_at report it instead of waiting
+// for it. A segment whose allocation failed stays failed, so later claims
+// that land in it fail too.
+template <typename T>
+class ConcurrentVector
+{
+private:
+	static constexpr size_t first_segment_bits = 5;
+	static constexpr size_t first_segment_size = size_t(1) << first_segment_bits;
+	static constexpr size_t max_segments       = sizeof(size_t) * 8 - first_segment_bits + 1;
+
+	enum class SlotState : unsigned char { Empty, Ready, Failed };
+
+	struct Slot
+	{
+		std::atomic<SlotState> state;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		Slot() : state(SlotState::Empty) { }
+
+		T*       value()       { return reinterpret_cast<T*>(storage); }
+		const T* value() const { return reinterpret_cast<const T*>(storage); }
+	};
+
+	std::atomic<size_t> size;
+	std::atomic<Slot*>  segments[max_segments];
+
+public:
+	ConcurrentVector();
+	~ConcurrentVector();
+
+	ConcurrentVector(const ConcurrentVector&) = delete;
+	ConcurrentVector& operator=(const ConcurrentVector&) = delete;
+
+	size_t push_back(const T& element);
+	size_t push_back(T&& element);
+
+	template <typename... Args>
+	size_t emplace_back(Args&&... args);
+
+	const T& at(size_t index) const;
+
+	// Returns std::nullopt where at would throw.
+	std::optional<T> try_at(size_t index) const;
+
+	size_t get_size() const;
+	size_t get_length() const;
+	size_t get_capacity() const;
+
+	const T& operator[](size_t index) const;
+
+private:
+	Slot*       slot_at(size_t index);
+	const Slot* slot_at(size_t index) const;
+	Slot*       get_segment(size_t segment);
+
+	static bool wait_until_built(const Slot* slot);
+
+	static Slot*  failed_segment();
+	static size_t segment_of(size_t index);
+	static size_t segment_start(size_t segment);
+	static size_t segment_length(size_t segment);
+};
+
+template <typename T>
+ConcurrentVector<T>::ConcurrentVector()
+	: size(0)
+{
+	for (size_t i = 0; i < max_segments; i++)
+		segments[i].store(nullptr, std::memory_order_relaxed);
+}
+
+template <typename T>
+ConcurrentVector<T>::~ConcurrentVector()
+{
+	for (size_t segment = 0; segment < max_segments; segment++)
+	{
+		Slot* slots = segments[segment].load(std::memory_order_relaxed);
+		if (!slots || slots == failed_segment())
+			continue;
+
+		for (size_t i = 0; i < segment_length(segment); i++)
+		{
+			if (slots[i].state.load(std::memory_order_relaxed) == SlotState::Ready)
+				slots[i].value()->~T();
+		}
+
+		delete[] slots;
+	}
+}
+
+// Installed in place of a segment whose allocation threw.
+template <typename T>
+typename ConcurrentVector<T>::Slot* ConcurrentVector<T>::failed_segment()
+{
+	static Slot marker;
+
+	return &marker;
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::segment_of(size_t index)
+{
+	size_t bucket = index >> first_segment_bits;
+	size_t segment = 0;
+
+	while (bucket)
+	{
+		bucket >>= 1;
+		segment++;
+	}
+
+	return segment;
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::segment_start(size_t segment)
+{
+	return segment == 0 ? 0 : first_segment_size << (segment - 1);
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::segment_length(size_t segment)
+{
+	return segment == 0 ? first_segment_size : first_segment_size << (segment - 1);
+}
+
+// Whoever first finds a segment missing allocates it; losers of the CAS free
+// their copy and use the winner's. If the allocation throws, the segment is
+// marked failed unless another writer installed it meanwhile.
+template <typename T>
+typename ConcurrentVector<T>::Slot* ConcurrentVector<T>::get_segment(size_t segment)
+{
+	Slot* slots = segments[segment].load(std::memory_order_acquire);
+	if (slots)
+		return slots;
+
+	Slot* fresh = nullptr;
+
+	DS_TRY
+	{
+		fresh = new Slot[segment_length(segment)];
+	}
+	DS_CATCH_ALL
+	{
+		if (segments[segment].compare_exchange_strong(slots, failed_segment(), std::memory_order_acq_rel, std::memory_order_acquire))
+			return failed_segment();
+
+		return slots;
+	}
+
+	if (segments[segment].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+		return fresh;
+
+	delete[] fresh;
+	return slots;
+}
+
+// Returns nullptr if the segment holding index failed to allocate.
+template <typename T>
+typename ConcurrentVector<T>::Slot* ConcurrentVector<T>::slot_at(size_t index)
+{
+	size_t segment = segment_of(index);
+	Slot* slots = get_segment(segment);
+
+	if (slots == failed_segment())
+		return nullptr;
+
+	return slots + (index - segment_start(segment));
+}
+
+template <typename T>
+const typename ConcurrentVector<T>::Slot* ConcurrentVector<T>::slot_at(size_t index) const
+{
+	size_t segment = segment_of(index);
+	const Slot* slots = nullptr;
+
+	// The writer that claimed this index may still be installing the segment.
+	while (!(slots = segments[segment].load(std::memory_order_acquire)))
+		std::this_thread::yield();
+
+	if (slots == failed_segment())
+		return nullptr;
+
+	return slots + (index - segment_start(segment));
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::push_back(const T& element)
+{
+	return emplace_back(element);
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::push_back(T&& element)
+{
+	return emplace_back(std::move(element));
+}
+
+template <typename T>
+template <typename... Args>
+size_t ConcurrentVector<T>::emplace_back(Args&&... args)
+{
+	size_t index = size.fetch_add(1, std::memory_order_relaxed);
+	Slot* slot = slot_at(index);
+
+	if (!slot)
+		DS_THROW(std::bad_alloc());
+
+	DS_TRY
+	{
+		::new (static_cast<void*>(slot->storage)) T(std::forward<Args>(args)...);
+	}
+	DS_CATCH_ALL
+	{
+		slot->state.store(SlotState::Failed, std::memory_order_release);
+		DS_RETHROW;
+	}
+
+	slot->state.store(SlotState::Ready, std::memory_order_release);
+
+	return index;
+}
+
+// Waits for the writer that claimed the slot to finish, and returns whether
+// it stored an element.
+template <typename T>
+bool ConcurrentVector<T>::wait_until_built(const Slot* slot)
+{
+	if (!slot)
+		return false;
+
+	SlotState state;
+
+	while ((state = slot->state.load(std::memory_order_acquire)) == SlotState::Empty)
+		std::this_thread::yield();
+
+	return state == SlotState::Ready;
+}
+
+template <typename T>
+const T& ConcurrentVector<T>::at(size_t index) const
+{
+	if (index >= size.load(std::memory_order_acquire))
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	const Slot* slot = slot_at(index);
+
+	if (!wait_until_built(slot))
+		DS_THROW(std::runtime_error("Element construction failed"));
+
+	return *slot->value();
+}
+
+template <typename T>
+std::optional<T> ConcurrentVector<T>::try_at(size_t index) const
+{
+	if (index >= size.load(std::memory_order_acquire))
+		return std::nullopt;
+
+	const Slot* slot = slot_at(index);
+
+	if (!wait_until_built(slot))
+		return std::nullopt;
+
+	return *slot->value();
+}
+
+template <typename T>
+const T& ConcurrentVector<T>::operator[](size_t index) const
+{
+	return at(index);
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::get_length() const
+{
+	return size.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t ConcurrentVector<T>::get_capacity() const
+{
+	size_t capacity = 0;
+
+	for (size_t segment = 0; segment < max_segments; segment++)
+	{
+		Slot* slots = segments[segment].load(std::memory_order_acquire);
+
+		if (slots && slots != failed_segment())
+			capacity += segment_length(segment);
+	}
+
+	return capacity;
+}
+
+#endif
@@ -1,18 +1,25 @@
 #ifndef DOUBLYLINKEDLIST_H
 #define DOUBLYLINKEDLIST_H
 
-#include <iostream>
-#include <functional>
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
 #include <stdexcept>
+#include <utility>
 
-template <typename T>
+#include "exceptions.h"
+#include "lockpolicy.h"
+
+template <typename T, typename Lock = RuntimeLock, typename Allocator = std::allocator<T>>
 class DoublyLinkedList
 {
 private:
-	size_t             size;
-	mutable std::mutex mutex;
-	bool               is_thread_safe;
+	size_t       size;
+	mutable Lock mutex;
 
 	struct Node
 	{
@@ -20,128 +27,289 @@ private:
 		Node* next;
 		Node* previous;
 
-		Node(const T& data) : data(data), next(nullptr), previous(nullptr) { }
+		template <typename... Args>
+		Node(Args&&... args) : data(std::forward<Args>(args)...), next(nullptr), previous(nullptr) { }
 	};
 
-	Node* head;
-	Node* tail;
+	using NodeAllocator       = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+	using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
 
-public:
-	std::function<void(const T&)>      push_front;
-	std::function<void(const T&)>      push_back;
-	std::function<void(const T&, int)> push_at;
-	std::function<T()>                 pop_front;
-	std::function<T()>                 pop_back;
-	std::function<T(int)>              pop_at;
-	std::function<void()>              clear;
-	std::function<T()>                 get_head;
-	std::function<T()>                 get_tail;
-	std::function<T(int)>              at;
-	std::function<size_t()>            get_size;
-	std::function<size_t()>            get_length;
+	// See Queue: only stateless allocators are called outside the lock.
+	static constexpr bool allocates_outside_lock = NodeAllocatorTraits::is_always_equal::value;
+
+	// Slab storage: nodes are carved out of arrays of slab_size nodes, and a
+	// freed node's storage is kept on a freelist until the slabs go away.
+	struct Slab
+	{
+		Node*  nodes;
+		size_t capacity;
+		Slab*  next;
+	};
+
+	struct FreeNode
+	{
+		FreeNode* next;
+	};
+
+	using SlabAllocator       = typename std::allocator_traits<Allocator>::template rebind_alloc<Slab>;
+	using SlabAllocatorTraits = std::allocator_traits<SlabAllocator>;
+
+	NodeAllocator node_allocator;
+	Node*         head;
+	Node*         tail;
+	size_t        slab_size;
+	Slab*         slabs;
+	Node*         slab_cursor;
+	Node*         slab_end;
+	FreeNode*     free_nodes;
 
 public:
-	DoublyLinkedList(bool is_thread_safe);
+	static constexpr size_t default_slab_size = 4096;
+
+	explicit DoublyLinkedList(const Allocator& allocator = Allocator());
+
+	template <typename B, enable_if_bool<B> = 0>
+	explicit DoublyLinkedList(B is_thread_safe, const Allocator& allocator = Allocator());
+	DoublyLinkedList(DoublyLinkedList&& other);
 	~DoublyLinkedList();
 
+	DoublyLinkedList& operator=(DoublyLinkedList&& other);
+	DoublyLinkedList& operator=(const DoublyLinkedList&) = delete;
+
+	void             swap(DoublyLinkedList& other);
+	DoublyLinkedList clone() const;
+
+	void push_front(const T& element);
+	void push_front(T&& element);
+	void push_back(const T& element);
+	void push_back(T&& element);
+	void push_at(const T& element, int index);
+	void push_at(T&& element, int index);
+	T    pop_front();
+	T    pop_back();
+	T    pop_at(int index);
+	void clear();
+	T    get_head() const;
+	T    get_tail() const;
+	T    at(int index) const;
+
+	// Return std::nullopt where pop_front, pop_back and at would throw.
+	std::optional<T> try_pop_front();
+	std::optional<T> try_pop_back();
+	std::optional<T> try_at(int index) const;
+
+	size_t get_size() const;
+	size_t get_length() const;
+
+	Allocator get_allocator() const;
+
+	template <typename... Args>
+	void emplace_front(Args&&... args);
+
+	template <typename... Args>
+	void emplace_back(Args&&... args);
+
+	template <typename... Args>
+	void emplace_at(int index, Args&&... args);
+
+	template <typename InputIt>
+	void push_back_range(InputIt first, InputIt last);
+
+	// Calls function(element) on every element from head to tail under one
+	// shared lock.
+	template <typename Function>
+	void for_each(Function function) const;
+
+	// Switches to slab storage: nodes come from contiguous arrays of
+	// nodes_per_slab nodes instead of one allocation each. Existing nodes are
+	// moved into slabs. Make the switch before the list is shared between
+	// threads.
+	void use_slab_storage(size_t nodes_per_slab = default_slab_size);
+	bool uses_slab_storage() const;
+
+	// Moves every node, in list order, into one fresh slab and frees the old
+	// storage, so a traversal afterwards walks memory sequentially. Switches
+	// to slab storage if the list was not using it yet.
+	void compact();
+
 	const T& operator[](int index) const;
 
 private:
-	void initialize_functions();
-	bool is_empty();
+	DoublyLinkedList(const DoublyLinkedList& other);
+
+	bool  is_empty() const;
+	Node* node_at(int index) const;
+	void  destroy_nodes();
+	void  steal(DoublyLinkedList& other);
+	void  link_back(Node* new_node);
+
+	template <typename... Args>
+	Node* create_node(Args&&... args);
+	void  destroy_node(Node* node);
+	void  destroy_chain(Node* node);
+
+	bool  allocates_under_lock() const;
+	Node* allocate_node();
+	void  deallocate_node(Node* node);
+	void  add_slab(size_t capacity);
+	void  release_slabs(Slab* slab);
+	void  compact_nodes();
+};
+
+template <typename T, typename Lock, typename Allocator>
+DoublyLinkedList<T, Lock, Allocator>::DoublyLinkedList(const Allocator& allocator)
+	: size(0), node_allocator(allocator), head(nullptr), tail(nullptr),
+	  slab_size(0), slabs(nullptr), slab_cursor(nullptr), slab_end(nullptr), free_nodes(nullptr)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+template <typename B, enable_if_bool<B>>
+DoublyLinkedList<T, Lock, Allocator>::DoublyLinkedList(B is_thread_safe, const Allocator& allocator)
+	: size(0), mutex(is_thread_safe), node_allocator(allocator), head(nullptr), tail(nullptr),
+	  slab_size(0), slabs(nullptr), slab_cursor(nullptr), slab_end(nullptr), free_nodes(nullptr)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+DoublyLinkedList<T, Lock, Allocator>::DoublyLinkedList(const DoublyLinkedList& other)
+	: size(0), mutex(other.mutex),
+	  node_allocator(NodeAllocatorTraits::select_on_container_copy_construction(other.node_allocator)),
+	  head(nullptr), tail(nullptr),
+	  slab_size(other.slab_size), slabs(nullptr), slab_cursor(nullptr), slab_end(nullptr), free_nodes(nullptr)
+{
+	std::shared_lock<Lock> lock(other.mutex);
 
-	void thread_safe_push_front(const T& element);
-	void no_thread_safe_push_front(const T& element);
+	DS_TRY
+	{
+		for (Node* current = other.head; current; current = current->next)
+			link_back(create_node(current->data));
+	}
+	DS_CATCH_ALL
+	{
+		destroy_nodes();
+		DS_RETHROW;
+	}
+}
 
-	void thread_safe_push_back(const T& element);
-	void no_thread_safe_push_back(const T& element);
+template <typename T, typename Lock, typename Allocator>
+DoublyLinkedList<T, Lock, Allocator>::DoublyLinkedList(DoublyLinkedList&& other)
+	: mutex(other.mutex), node_allocator(other.node_allocator)
+{
+	std::lock_guard<Lock> lock(other.mutex);
 
-	void thread_safe_push_at(const T& element, int index);
-	void no_thread_safe_push_at(const T& element, int index);
+	steal(other);
+}
 
-	T thread_safe_pop_front();
-	T no_thread_safe_pop_front();
-	
-	T thread_safe_pop_back();
-	T no_thread_safe_pop_back();
+template <typename T, typename Lock, typename Allocator>
+DoublyLinkedList<T, Lock, Allocator>::~DoublyLinkedList()
+{
+	destroy_nodes();
+}
 
-	T thread_safe_pop_at(int index);
-	T no_thread_safe_pop_at(int index);
+template <typename T, typename Lock, typename Allocator>
+DoublyLinkedList<T, Lock, Allocator>& DoublyLinkedList<T, Lock, Allocator>::operator=(DoublyLinkedList&& other)
+{
+	if (this == &other)
+		return *this;
 
-	void thread_safe_clear();
-	void no_thread_safe_clear();
+	PairLockGuard<Lock> lock(mutex, other.mutex);
 
-	T thread_safe_get_head();
-	T no_thread_safe_get_head();
+	destroy_nodes();
 
-	T thread_safe_get_tail();
-	T no_thread_safe_get_tail();
+	if (NodeAllocatorTraits::propagate_on_container_move_assignment::value || node_allocator == other.node_allocator)
+	{
+		if constexpr (NodeAllocatorTraits::propagate_on_container_move_assignment::value)
+			node_allocator = std::move(other.node_allocator);
 
-	T thread_safe_at(int index);
-	T no_thread_safe_at(int index);
+		steal(other);
+	}
+	else
+	{
+		for (Node* current = other.head; current; current = current->next)
+			link_back(create_node(std::move(current->data)));
 
-	size_t thread_safe_get_size();
-	size_t no_thread_safe_get_size();
+		other.destroy_nodes();
+	}
 
-	size_t thread_safe_get_length();
-	size_t no_thread_safe_get_length();
-};
+	return *this;
+}
 
-template <typename T>
-DoublyLinkedList<T>::DoublyLinkedList(bool is_thread_safe)
-	: size(0), is_thread_safe(is_thread_safe)
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::swap(DoublyLinkedList& other)
 {
-	initialize_functions();
+	if (this == &other)
+		return;
+
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	if constexpr (NodeAllocatorTraits::propagate_on_container_swap::value)
+		std::swap(node_allocator, other.node_allocator);
+	else if (!(node_allocator == other.node_allocator))
+		DS_THROW(std::invalid_argument("Cannot swap containers with unequal allocators"));
+
+	std::swap(size, other.size);
+	std::swap(head, other.head);
+	std::swap(tail, other.tail);
+	std::swap(slab_size, other.slab_size);
+	std::swap(slabs, other.slabs);
+	std::swap(slab_cursor, other.slab_cursor);
+	std::swap(slab_end, other.slab_end);
+	std::swap(free_nodes, other.free_nodes);
 }
 
-template <typename T>
-DoublyLinkedList<T>::~DoublyLinkedList()
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::steal(DoublyLinkedList& other)
 {
-	if (!is_empty())
-		clear();
+	size        = other.size;
+	head        = other.head;
+	tail        = other.tail;
+	slab_size   = other.slab_size;
+	slabs       = other.slabs;
+	slab_cursor = other.slab_cursor;
+	slab_end    = other.slab_end;
+	free_nodes  = other.free_nodes;
+
+	other.size        = 0;
+	other.head        = nullptr;
+	other.tail        = nullptr;
+	other.slabs       = nullptr;
+	other.slab_cursor = nullptr;
+	other.slab_end    = nullptr;
+	other.free_nodes  = nullptr;
 }
 
-template <typename T>
-const T& DoublyLinkedList<T>::operator[](int index) const
+template <typename T, typename Lock, typename Allocator>
+DoublyLinkedList<T, Lock, Allocator> DoublyLinkedList<T, Lock, Allocator>::clone() const
 {
-	if (is_thread_safe)
-	{
-		std::lock_guard<std::mutex> lock(mutex);
-
-		if (index == 0)
-			return head->data;
+	return DoublyLinkedList(*this);
+}
 
-		else if (index == size - 1)
-			return tail->data;
+template <typename T, typename Lock, typename Allocator>
+const T& DoublyLinkedList<T, Lock, Allocator>::operator[](int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
 
-		bool is_close_to_head = (index <= (size - index));
-		Node* current = is_close_to_head ? head : tail;
+	if (index < 0 || index >= size)
+		DS_THROW(std::out_of_range("Index out of range"));
 
-		if (is_close_to_head)
-		{
-			for (int i = 1; i <= index; i++)
-			{
-				current = current->next;
-			}
+	return node_at(index)->data;
+}
 
-			return current->data;
-		}
-		else
-		{
-			for (int i = size - 2; i >= index; i--)
-			{
-				current = current->previous;
-			}
+template <typename T, typename Lock, typename Allocator>
+bool DoublyLinkedList<T, Lock, Allocator>::is_empty() const
+{
+	return (size == 0);
+}
 
-			return current->data;
-		}
-	}
-	
+template <typename T, typename Lock, typename Allocator>
+typename DoublyLinkedList<T, Lock, Allocator>::Node* DoublyLinkedList<T, Lock, Allocator>::node_at(int index) const
+{
 	if (index == 0)
-		return head->data;
+		return head;
 
 	else if (index == size - 1)
-		return tail->data;
+		return tail;
 
 	bool is_close_to_head = (index <= (size - index));
 	Node* current = is_close_to_head ? head : tail;
@@ -152,8 +320,6 @@ const T& DoublyLinkedList<T>::operator[](int index) const
 		{
 			current = current->next;
 		}
-
-		return current->data;
 	}
 	else
 	{
@@ -161,546 +327,646 @@ const T& DoublyLinkedList<T>::operator[](int index) const
 		{
 			current = current->previous;
 		}
-
-		return current->data;
 	}
+
+	return current;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::initialize_functions()
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::destroy_nodes()
 {
-	if (is_thread_safe)
+	if (slab_size)
 	{
-		push_front = [this](const T& element) { thread_safe_push_front(element); };
-		push_back = [this](const T& element) { thread_safe_push_back(element); };
-		push_at = [this](const T& element, int index) { thread_safe_push_at(element, index); };
-		
-		pop_front  = [this]() { return this->thread_safe_pop_front(); };
-		pop_back   = [this]() { return this->thread_safe_pop_back(); };
-		pop_at     = [this](int index) { return this->thread_safe_pop_at(index); };
-
-		clear      = [this]() { thread_safe_clear(); };
-		
-		get_head   = [this]() { return this->thread_safe_get_head(); };
-		get_tail   = [this]() { return this->thread_safe_get_tail(); };
-		at         = [this](int index) { return this->thread_safe_at(index); };
-
-		get_size   = [this]() { return this->thread_safe_get_size(); };
-		get_length = [this]() { return this->thread_safe_get_length(); };
+		// Slab nodes are freed with their slabs, so only the elements need
+		// destroying.
+		for (Node* node = head; node; node = node->next)
+			NodeAllocatorTraits::destroy(node_allocator, node);
+
+		release_slabs(slabs);
+
+		slabs = nullptr;
+		slab_cursor = slab_end = nullptr;
+		free_nodes = nullptr;
 	}
 	else
 	{
-		push_front = [this](const T& element) { no_thread_safe_push_front(element); };
-		push_back = [this](const T& element) { no_thread_safe_push_back(element); };
-		push_at = [this](const T& element, int index) { no_thread_safe_push_at(element, index); };
-
-		pop_front  = [this]() { return this->no_thread_safe_pop_front(); };
-		pop_back   = [this]() { return this->no_thread_safe_pop_back(); };
-		pop_at     = [this](int index) { return this->no_thread_safe_pop_at(index); };
-
-		clear      = [this]() { no_thread_safe_clear(); };
-
-		get_head   = [this]() { return this->no_thread_safe_get_head(); };
-		get_tail   = [this]() { return this->no_thread_safe_get_tail(); };
-		at         = [this](int index) { return this->no_thread_safe_at(index); };
-
-		get_size   = [this]() { return this->no_thread_safe_get_size(); };
-		get_length = [this]() { return this->no_thread_safe_get_length(); };
+		destroy_chain(head);
 	}
-}
 
-template <typename T>
-bool DoublyLinkedList<T>::is_empty()
-{
-	return (size == 0);
+	head = tail = nullptr;
+	size = 0;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::thread_safe_push_front(const T& element)
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::link_back(Node* new_node)
 {
-	std::lock_guard<std::mutex> lock(mutex);
-
-	Node* new_node = new Node(element);
-
 	if (is_empty())
 	{
 		head = tail = new_node;
 	}
 	else
 	{
-		new_node->next = head;
-		head->previous = new_node;
-		head = new_node;
+		new_node->previous = tail;
+		tail->next = new_node;
+		tail = new_node;
 	}
 
 	size++;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::no_thread_safe_push_front(const T& element)
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+typename DoublyLinkedList<T, Lock, Allocator>::Node* DoublyLinkedList<T, Lock, Allocator>::create_node(Args&&... args)
 {
-	Node* new_node = new Node(element);
+	Node* node = allocate_node();
 
-	if (is_empty())
+	DS_TRY
 	{
-		head = tail = new_node;
+		NodeAllocatorTraits::construct(node_allocator, node, std::forward<Args>(args)...);
 	}
-	else
+	DS_CATCH_ALL
 	{
-		new_node->next = head;
-		head->previous = new_node;
-		head = new_node;
+		deallocate_node(node);
+		DS_RETHROW;
 	}
 
-	size++;
+	return node;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::thread_safe_push_back(const T& element)
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::destroy_node(Node* node)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	NodeAllocatorTraits::destroy(node_allocator, node);
+	deallocate_node(node);
+}
 
-	Node* new_node = new Node(element);
+// Slab storage is shared by every node of the list, so it is only touched
+// under the lock.
+template <typename T, typename Lock, typename Allocator>
+bool DoublyLinkedList<T, Lock, Allocator>::allocates_under_lock() const
+{
+	return !allocates_outside_lock || slab_size;
+}
 
-	if (is_empty())
-	{
-		tail = head = new_node;
-	}
-	else
+template <typename T, typename Lock, typename Allocator>
+typename DoublyLinkedList<T, Lock, Allocator>::Node* DoublyLinkedList<T, Lock, Allocator>::allocate_node()
+{
+	if (!slab_size)
+		return NodeAllocatorTraits::allocate(node_allocator, 1);
+
+	if (free_nodes)
 	{
-		new_node->previous = tail;
-		tail->next = new_node;
-		tail = new_node;
+		FreeNode* storage = free_nodes;
+		free_nodes = storage->next;
+
+		return reinterpret_cast<Node*>(storage);
 	}
 
-	size++;
+	if (slab_cursor == slab_end)
+		add_slab(slab_size);
+
+	return slab_cursor++;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::no_thread_safe_push_back(const T& element)
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::deallocate_node(Node* node)
 {
-	Node* new_node = new Node(element);
+	if (slab_size)
+		free_nodes = ::new (static_cast<void*>(node)) FreeNode{ free_nodes };
+	else
+		NodeAllocatorTraits::deallocate(node_allocator, node, 1);
+}
 
-	if (is_empty())
+// The new slab becomes the bump-allocation target; whatever was left in the
+// previous one stays unused until the slabs are released.
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::add_slab(size_t capacity)
+{
+	SlabAllocator slab_allocator(node_allocator);
+
+	Slab* slab = SlabAllocatorTraits::allocate(slab_allocator, 1);
+
+	DS_TRY
 	{
-		tail = head = new_node;
+		slab->nodes = NodeAllocatorTraits::allocate(node_allocator, capacity);
 	}
-	else
+	DS_CATCH_ALL
 	{
-		new_node->previous = tail;
-		tail->next = new_node;
-		tail = new_node;
+		SlabAllocatorTraits::deallocate(slab_allocator, slab, 1);
+		DS_RETHROW;
 	}
 
-	size++;
+	slab->capacity = capacity;
+	slab->next = slabs;
+	slabs = slab;
+
+	slab_cursor = slab->nodes;
+	slab_end = slab->nodes + capacity;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::thread_safe_push_at(const T& element, int index)
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::release_slabs(Slab* slab)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	SlabAllocator slab_allocator(node_allocator);
 
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	while (slab)
+	{
+		Slab* next = slab->next;
 
-	if (index <= 0 || index >= size - 1)
-		throw std::out_of_range("Index out of range");
+		NodeAllocatorTraits::deallocate(node_allocator, slab->nodes, slab->capacity);
+		SlabAllocatorTraits::deallocate(slab_allocator, slab, 1);
 
-	Node* new_node = new Node(element);
+		slab = next;
+	}
+}
 
-	bool is_close_to_head = (index <= (size - index));
-	Node* current_node = is_close_to_head ? head : tail;
-	Node* next_node;
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::use_slab_storage(size_t nodes_per_slab)
+{
+	std::lock_guard<Lock> lock(mutex);
 
-	if (is_close_to_head)
-	{
-		for (int i = 1; i < index; i++)
-		{
-			current_node = current_node->next;
-		}
+	if (!nodes_per_slab)
+		nodes_per_slab = default_slab_size;
 
-		next_node = current_node->next;
-		
-		current_node->next = new_node;
-		new_node->previous = current_node;
-		new_node->next = next_node;
-		next_node->previous = new_node;
-	}
-	else
+	if (slab_size)
 	{
-		for (int i = size - 2; i > index; i--)
-		{
-			current_node = current_node->previous;
-		}
+		slab_size = nodes_per_slab;
+		return;
+	}
 
-		next_node = current_node->next;
+	compact_nodes();
+	slab_size = nodes_per_slab;
+}
 
-		current_node->next = new_node;
-		new_node->previous = current_node;
-		new_node->next = next_node;
-		next_node->previous = new_node;
-	}
-	
-	size++;
+template <typename T, typename Lock, typename Allocator>
+bool DoublyLinkedList<T, Lock, Allocator>::uses_slab_storage() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return slab_size != 0;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::no_thread_safe_push_at(const T& element, int index)
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::compact()
 {
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	std::lock_guard<Lock> lock(mutex);
 
-	if (index <= 0 || index >= size - 1)
-		throw std::out_of_range("Index out of range");
+	compact_nodes();
 
-	Node* new_node = new Node(element);
+	if (!slab_size)
+		slab_size = default_slab_size;
+}
 
-	bool is_close_to_head = (index <= (size - index));
-	Node* current_node = is_close_to_head ? head : tail;
-	Node* next_node;
+// Copies the list into one slab sized to fit it, in list order. The elements
+// are moved if that cannot throw, so a failure leaves the list untouched.
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::compact_nodes()
+{
+	bool      in_slabs = slab_size != 0;
+	Slab*     old_slabs = slabs;
+	Node*     old_cursor = slab_cursor;
+	Node*     old_end = slab_end;
+	FreeNode* old_free_nodes = free_nodes;
 
-	if (is_close_to_head)
+	slabs = nullptr;
+	slab_cursor = slab_end = nullptr;
+	free_nodes = nullptr;
+
+	Node* new_head = nullptr;
+	Node* new_tail = nullptr;
+
+	DS_TRY
 	{
-		for (int i = 1; i < index; i++)
+		if (size)
+			add_slab(std::max(size, slab_size));
+
+		for (Node* current = head; current; current = current->next)
 		{
-			current_node = current_node->next;
+			Node* node = slab_cursor++;
+			NodeAllocatorTraits::construct(node_allocator, node, std::move_if_noexcept(current->data));
+
+			node->previous = new_tail;
+			if (new_tail)
+				new_tail->next = node;
+			else
+				new_head = node;
+
+			new_tail = node;
 		}
+	}
+	DS_CATCH_ALL
+	{
+		for (Node* node = new_head; node; node = node->next)
+			NodeAllocatorTraits::destroy(node_allocator, node);
 
-		next_node = current_node->next;
+		release_slabs(slabs);
 
-		current_node->next = new_node;
-		new_node->previous = current_node;
-		new_node->next = next_node;
-		next_node->previous = new_node;
+		slabs = old_slabs;
+		slab_cursor = old_cursor;
+		slab_end = old_end;
+		free_nodes = old_free_nodes;
+		DS_RETHROW;
 	}
-	else
+
+	for (Node* node = head; node; )
 	{
-		for (int i = size - 2; i > index; i--)
-		{
-			current_node = current_node->previous;
-		}
+		Node* next = node->next;
+		NodeAllocatorTraits::destroy(node_allocator, node);
 
-		next_node = current_node->next;
+		if (!in_slabs)
+			NodeAllocatorTraits::deallocate(node_allocator, node, 1);
 
-		current_node->next = new_node;
-		new_node->previous = current_node;
-		new_node->next = next_node;
-		next_node->previous = new_node;
+		node = next;
 	}
 
-	size++;
+	release_slabs(old_slabs);
+
+	head = new_head;
+	tail = new_tail;
 }
 
-template <typename T>
-T DoublyLinkedList<T>::thread_safe_pop_front()
+template <typename T, typename Lock, typename Allocator>
+template <typename Function>
+void DoublyLinkedList<T, Lock, Allocator>::for_each(Function function) const
 {
-	std::lock_guard<std::mutex> lock(mutex);
-
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	std::shared_lock<Lock> lock(mutex);
 
-	head = head->next;
-	head->previous = nullptr;
+	for (Node* node = head; node; node = node->next)
+		function(static_cast<const T&>(node->data));
+}
 
-	size--;
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::destroy_chain(Node* node)
+{
+	while (node)
+	{
+		Node* next = node->next;
+		destroy_node(node);
+		node = next;
+	}
 }
 
-template <typename T>
-T DoublyLinkedList<T>::no_thread_safe_pop_front()
+template <typename T, typename Lock, typename Allocator>
+Allocator DoublyLinkedList<T, Lock, Allocator>::get_allocator() const
 {
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	return Allocator(node_allocator);
+}
 
-	head = head->next;
-	head->previous = nullptr;
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::push_front(const T& element)
+{
+	emplace_front(element);
+}
 
-	size--;
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::push_front(T&& element)
+{
+	emplace_front(std::move(element));
 }
 
-template <typename T>
-T DoublyLinkedList<T>::thread_safe_pop_back()
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+void DoublyLinkedList<T, Lock, Allocator>::emplace_front(Args&&... args)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<Lock> lock(mutex, std::defer_lock);
+
+	if (allocates_under_lock())
+		lock.lock();
+
+	Node* new_node = create_node(std::forward<Args>(args)...);
+
+	if (!lock.owns_lock())
+		lock.lock();
 
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	{
+		head = tail = new_node;
+	}
+	else
+	{
+		new_node->next = head;
+		head->previous = new_node;
+		head = new_node;
+	}
 
-	tail = tail->previous;
-	tail->next = nullptr;
+	size++;
+}
 
-	size--;
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::push_back(const T& element)
+{
+	emplace_back(element);
 }
 
-template <typename T>
-T DoublyLinkedList<T>::no_thread_safe_pop_back()
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::push_back(T&& element)
 {
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	emplace_back(std::move(element));
+}
 
-	tail = tail->previous;
-	tail->next = nullptr;
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+void DoublyLinkedList<T, Lock, Allocator>::emplace_back(Args&&... args)
+{
+	std::unique_lock<Lock> lock(mutex, std::defer_lock);
 
-	size--;
+	if (allocates_under_lock())
+		lock.lock();
+
+	Node* new_node = create_node(std::forward<Args>(args)...);
+
+	if (!lock.owns_lock())
+		lock.lock();
+
+	link_back(new_node);
 }
 
-template <typename T>
-T DoublyLinkedList<T>::thread_safe_pop_at(int index)
+// Links the new nodes together outside the lock, then splices the chain onto
+// the tail with one acquisition.
+template <typename T, typename Lock, typename Allocator>
+template <typename InputIt>
+void DoublyLinkedList<T, Lock, Allocator>::push_back_range(InputIt first, InputIt last)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<Lock> lock(mutex, std::defer_lock);
 
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
-
-	if (index <= 0 || index >= size - 1)
-		throw std::out_of_range("Index out of range");
+	if (allocates_under_lock())
+		lock.lock();
 
-	bool is_close_to_head = (index <= (size - index));
-	Node* current_node = is_close_to_head ? head : tail;
-	Node* next_node;
-	Node* previous_node;
+	Node*  chain_head = nullptr;
+	Node*  chain_tail = nullptr;
+	size_t count = 0;
 
-	if (is_close_to_head)
+	DS_TRY
 	{
-		for (int i = 1; i <= index; i++)
+		for (; first != last; ++first, ++count)
 		{
-			current_node = current_node->next;
+			Node* new_node = create_node(*first);
+
+			if (chain_tail)
+			{
+				new_node->previous = chain_tail;
+				chain_tail->next = new_node;
+				chain_tail = new_node;
+			}
+			else
+			{
+				chain_head = chain_tail = new_node;
+			}
 		}
+	}
+	DS_CATCH_ALL
+	{
+		destroy_chain(chain_head);
+		DS_RETHROW;
+	}
 
-		previous_node = current_node->previous;
-		next_node = current_node->next;
+	if (!count)
+		return;
 
-		previous_node->next = next_node;
-		next_node->previous = previous_node;
+	if (!lock.owns_lock())
+		lock.lock();
 
-		current_node = nullptr;
+	if (is_empty())
+	{
+		head = chain_head;
 	}
 	else
 	{
-		for (int i = 1; i <= index; i++)
-		{
-			current_node = current_node->next;
-		}
-
-		previous_node = current_node->previous;
-		next_node = current_node->next;
+		chain_head->previous = tail;
+		tail->next = chain_head;
+	}
 
-		previous_node->next = next_node;
-		next_node->previous = previous_node;
+	tail = chain_tail;
+	size += count;
+}
 
-		current_node = nullptr;
-	}
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::push_at(const T& element, int index)
+{
+	emplace_at(index, element);
+}
 
-	size--;
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::push_at(T&& element, int index)
+{
+	emplace_at(index, std::move(element));
 }
 
-template <typename T>
-T DoublyLinkedList<T>::no_thread_safe_pop_at(int index)
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+void DoublyLinkedList<T, Lock, Allocator>::emplace_at(int index, Args&&... args)
 {
+	std::lock_guard<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
 	if (index <= 0 || index >= size - 1)
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	bool is_close_to_head = (index <= (size - index));
-	Node* current_node = is_close_to_head ? head : tail;
-	Node* next_node;
-	Node* previous_node;
+	Node* new_node = create_node(std::forward<Args>(args)...);
 
-	if (is_close_to_head)
-	{
-		for (int i = 1; i <= index; i++)
-		{
-			current_node = current_node->next;
-		}
+	Node* current_node = node_at(index - 1);
+	Node* next_node = current_node->next;
 
-		previous_node = current_node->previous;
-		next_node = current_node->next;
+	current_node->next = new_node;
+	new_node->previous = current_node;
+	new_node->next = next_node;
+	next_node->previous = new_node;
 
-		previous_node->next = next_node;
-		next_node->previous = previous_node;
+	size++;
+}
 
-		current_node = nullptr;
-	}
-	else
-	{
-		for (int i = 1; i <= index; i++)
-		{
-			current_node = current_node->next;
-		}
+template <typename T, typename Lock, typename Allocator>
+T DoublyLinkedList<T, Lock, Allocator>::pop_front()
+{
+	std::lock_guard<Lock> lock(mutex);
 
-		previous_node = current_node->previous;
-		next_node = current_node->next;
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
 
-		previous_node->next = next_node;
-		next_node->previous = previous_node;
+	Node* popped_node = head;
+	T popped_element = std::move(popped_node->data);
 
-		current_node = nullptr;
-	}
+	head = head->next;
+	if (head)
+		head->previous = nullptr;
+	else
+		tail = nullptr;
 
+	destroy_node(popped_node);
 	size--;
+
+	return popped_element;
 }
 
-template <typename T>
-void DoublyLinkedList<T>::thread_safe_clear()
+template <typename T, typename Lock, typename Allocator>
+T DoublyLinkedList<T, Lock, Allocator>::pop_back()
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::lock_guard<Lock> lock(mutex);
 
-	for (Node* node = head; node; )
-	{
-		node = head->next;
-		delete head;
-		head = node;
-	}
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	size = 0;
-}
+	Node* popped_node = tail;
+	T popped_element = std::move(popped_node->data);
 
-template <typename T>
-void DoublyLinkedList<T>::no_thread_safe_clear()
-{
-	for (Node* node = head; node; )
-	{
-		node = head->next;
-		delete head;
-		head = node;
-	}
+	tail = tail->previous;
+	if (tail)
+		tail->next = nullptr;
+	else
+		head = nullptr;
 
-	size = 0;
+	destroy_node(popped_node);
+	size--;
+
+	return popped_element;
 }
 
-template <typename T>
-T DoublyLinkedList<T>::thread_safe_get_head()
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> DoublyLinkedList<T, Lock, Allocator>::try_pop_front()
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::lock_guard<Lock> lock(mutex);
 
-	return head->data;
-}
+	if (is_empty())
+		return std::nullopt;
 
-template <typename T>
-T DoublyLinkedList<T>::no_thread_safe_get_head()
-{
-	return head->data;
-}
+	Node* popped_node = head;
+	std::optional<T> popped_element(std::move(popped_node->data));
 
-template <typename T>
-T DoublyLinkedList<T>::thread_safe_get_tail()
-{
-	std::lock_guard<std::mutex> lock(mutex);
+	head = head->next;
+	if (head)
+		head->previous = nullptr;
+	else
+		tail = nullptr;
 
-	return tail->data;
+	destroy_node(popped_node);
+	size--;
+
+	return popped_element;
 }
 
-template <typename T>
-T DoublyLinkedList<T>::no_thread_safe_get_tail()
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> DoublyLinkedList<T, Lock, Allocator>::try_pop_back()
 {
-	return tail->data;
+	std::lock_guard<Lock> lock(mutex);
+
+	if (is_empty())
+		return std::nullopt;
+
+	Node* popped_node = tail;
+	std::optional<T> popped_element(std::move(popped_node->data));
+
+	tail = tail->previous;
+	if (tail)
+		tail->next = nullptr;
+	else
+		head = nullptr;
+
+	destroy_node(popped_node);
+	size--;
+
+	return popped_element;
 }
 
-template <typename T>
-T DoublyLinkedList<T>::thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+T DoublyLinkedList<T, Lock, Allocator>::pop_at(int index)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::lock_guard<Lock> lock(mutex);
 
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	else if (index == 0)
-		return head->data;
+	if (index <= 0 || index >= size - 1)
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	else if (index == size - 1)
-		return tail->data;
+	Node* current_node = node_at(index);
+	Node* previous_node = current_node->previous;
+	Node* next_node = current_node->next;
 
-	else if (index < 0 || index >= size)
-		throw std::out_of_range("Index out of range");
+	previous_node->next = next_node;
+	next_node->previous = previous_node;
 
-	bool is_close_to_head = (index <= (size - index));
-	Node* current = is_close_to_head ? head : tail;
+	T popped_element = std::move(current_node->data);
+	destroy_node(current_node);
 
-	if (is_close_to_head)
-	{
-		for (int i = 1; i <= index; i++)
-		{
-			current = current->next;
-		}
+	size--;
 
-		return current->data;
-	}
-	else
-	{
-		for (int i = size - 2; i >= index; i--)
-		{
-			current = current->previous;
-		}
+	return popped_element;
+}
 
-		return current->data;
-	}
+template <typename T, typename Lock, typename Allocator>
+void DoublyLinkedList<T, Lock, Allocator>::clear()
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	destroy_nodes();
 }
 
-template <typename T>
-T DoublyLinkedList<T>::no_thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+T DoublyLinkedList<T, Lock, Allocator>::get_head() const
 {
+	std::shared_lock<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	else if (index == 0)
-		return head->data;
+	return head->data;
+}
 
-	else if (index == size - 1)
-		return tail->data;
+template <typename T, typename Lock, typename Allocator>
+T DoublyLinkedList<T, Lock, Allocator>::get_tail() const
+{
+	std::shared_lock<Lock> lock(mutex);
 
-	else if (index < 0 || index >= size)
-		throw std::out_of_range("Index out of range");
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	bool is_close_to_head = (index <= (size - index));
-	Node* current = is_close_to_head ? head : tail;
+	return tail->data;
+}
 
-	if (is_close_to_head)
-	{
-		for (int i = 1; i <= index; i++)
-		{
-			current = current->next;
-		}
+template <typename T, typename Lock, typename Allocator>
+T DoublyLinkedList<T, Lock, Allocator>::at(int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
 
-		return current->data;
-	}
-	else
-	{
-		for (int i = size - 2; i >= index; i--)
-		{
-			current = current->previous;
-		}
+	if (index < 0 || index >= size)
+		DS_THROW(std::out_of_range("Index out of range"));
 
-		return current->data;
-	}
+	return node_at(index)->data;
 }
 
-template <typename T>
-size_t DoublyLinkedList<T>::thread_safe_get_size()
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> DoublyLinkedList<T, Lock, Allocator>::try_at(int index) const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
-	return size * sizeof(T);
+	if (index < 0 || index >= size)
+		return std::nullopt;
+
+	return node_at(index)->data;
 }
 
-template <typename T>
-size_t DoublyLinkedList<T>::no_thread_safe_get_size()
+template <typename T, typename Lock, typename Allocator>
+size_t DoublyLinkedList<T, Lock, Allocator>::get_size() const
 {
+	std::shared_lock<Lock> lock(mutex);
+
 	return size * sizeof(T);
 }
 
-template <typename T>
-size_t DoublyLinkedList<T>::thread_safe_get_length()
+template <typename T, typename Lock, typename Allocator>
+size_t DoublyLinkedList<T, Lock, Allocator>::get_length() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
 	return size;
 }
 
-template <typename T>
-size_t DoublyLinkedList<T>::no_thread_safe_get_length()
+namespace pmr
 {
-	return size;
+	template <typename T, typename Lock = RuntimeLock>
+	using DoublyLinkedList = ::DoublyLinkedList<T, Lock, std::pmr::polymorphic_allocator<T>>;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,39 @@
+#ifndef EXCEPTIONS_H
+#define EXCEPTIONS_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Error reporting that also compiles with -fno-exceptions. Building with
+// DS_NO_EXCEPTIONS defined (the DS_NO_EXCEPTIONS CMake option), or with a
+// compiler that has exceptions turned off, makes every DS_THROW print the
+// message and abort, and compiles the cleanup handlers that only exist to
+// rethrow down to nothing. The try_* accessors report empty and
+// out-of-range cases through std::optional or a bool instead, so code that
+// sticks to them behaves the same either way.
+#if !defined(DS_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS)
+#define DS_NO_EXCEPTIONS
+#endif
+
+#ifdef DS_NO_EXCEPTIONS
+#define DS_THROW(exception) ::exceptions::fail((exception).what())
+#define DS_TRY              if (true)
+#define DS_CATCH_ALL        else
+#define DS_RETHROW          ((void)0)
+#else
+#define DS_THROW(exception) throw exception
+#define DS_TRY              try
+#define DS_CATCH_ALL        catch (...)
+#define DS_RETHROW          throw
+#endif
+
+namespace exceptions
+{
+	[[noreturn]] inline void fail(const char* message)
+	{
+		std::fprintf(stderr, "%s\n", message);
+		std::abort();
+	}
+}
+
+#endif
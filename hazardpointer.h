@@ -0,0 +1,261 @@
+#ifndef HAZARDPOINTER_H
+#define HAZARDPOINTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "exceptions.h"
+
+// Hazard pointers for the lock-free containers. A thread publishes the node
+// it is about to dereference in one of its hazard slots; a node that has
+// been unlinked is retired instead of deleted and only freed once no slot
+// points at it. Because a protected node cannot be freed, it cannot be
+// reused either, which also rules out ABA on the protected pointer.
+namespace hazard
+{
+	constexpr size_t max_threads = 512;
+	constexpr size_t slots_per_thread = 2;
+
+	struct alignas(64) Record
+	{
+		std::atomic<bool>  active{ false };
+		std::atomic<void*> slots[slots_per_thread] = {};
+	};
+
+	struct Retired
+	{
+		void* pointer;
+		void (*deleter)(void*);
+	};
+
+	// The process-wide set of hazard records, plus the retired nodes left
+	// behind by threads that exited before they could free them.
+	class Domain
+	{
+	private:
+		Record              records[max_threads];
+		std::atomic<size_t> records_used{ 0 };
+
+		std::mutex           orphans_mutex;
+		std::vector<Retired> orphans;
+
+	public:
+		Domain() = default;
+		~Domain();
+
+		Domain(const Domain&) = delete;
+		Domain& operator=(const Domain&) = delete;
+
+		Record* acquire();
+		void    release(Record* record);
+		void    abandon(std::vector<Retired>& retired);
+		void    scan(std::vector<Retired>& retired);
+		size_t  get_records_used() const;
+	};
+
+	inline Domain& domain()
+	{
+		static Domain instance;
+
+		return instance;
+	}
+
+	// Each thread's hazard record and the nodes it has retired.
+	class ThreadState
+	{
+	private:
+		Record*              record;
+		std::vector<Retired> retired;
+
+	public:
+		ThreadState();
+		~ThreadState();
+
+		std::atomic<void*>& slot(size_t index);
+		void                retire(void* pointer, void (*deleter)(void*));
+		void                reclaim();
+	};
+
+	inline ThreadState& thread_state()
+	{
+		thread_local ThreadState state;
+
+		return state;
+	}
+
+	// Publishes one pointer in the calling thread's slot for as long as the
+	// guard lives. Each slot index must be used by at most one live guard per
+	// thread.
+	class Guard
+	{
+	private:
+		std::atomic<void*>& slot;
+
+	public:
+		explicit Guard(size_t index = 0) : slot(thread_state().slot(index)) { }
+		~Guard() { reset(); }
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+		// Loads source and publishes it, repeating until the published value
+		// is still current, so the result stays valid until reset().
+		template <typename P>
+		P* protect(const std::atomic<P*>& source)
+		{
+			P* pointer = source.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				slot.store(pointer, std::memory_order_seq_cst);
+
+				P* current = source.load(std::memory_order_seq_cst);
+				if (current == pointer)
+					return pointer;
+
+				pointer = current;
+			}
+		}
+
+		void reset()
+		{
+			slot.store(nullptr, std::memory_order_release);
+		}
+	};
+
+	// Hands an unlinked node over for deletion once nothing protects it.
+	template <typename T>
+	void retire(T* pointer)
+	{
+		thread_state().retire(pointer, [](void* node) { delete static_cast<T*>(node); });
+	}
+
+	inline Domain::~Domain()
+	{
+		for (Retired& node : orphans)
+			node.deleter(node.pointer);
+	}
+
+	inline Record* Domain::acquire()
+	{
+		for (size_t i = 0; i < max_threads; i++)
+		{
+			bool expected = false;
+			if (!records[i].active.load(std::memory_order_relaxed) &&
+			    records[i].active.compare_exchange_strong(expected, true, std::memory_order_acquire))
+			{
+				size_t used = records_used.load(std::memory_order_relaxed);
+				while (used < i + 1 && !records_used.compare_exchange_weak(used, i + 1, std::memory_order_release)) { }
+
+				return &records[i];
+			}
+		}
+
+		DS_THROW(std::runtime_error("Too many threads using hazard pointers"));
+	}
+
+	inline void Domain::release(Record* record)
+	{
+		for (std::atomic<void*>& slot : record->slots)
+			slot.store(nullptr, std::memory_order_relaxed);
+
+		record->active.store(false, std::memory_order_release);
+	}
+
+	inline void Domain::abandon(std::vector<Retired>& retired)
+	{
+		std::lock_guard<std::mutex> lock(orphans_mutex);
+
+		orphans.insert(orphans.end(), retired.begin(), retired.end());
+		retired.clear();
+	}
+
+	// Frees every node in retired that no slot currently points at and keeps
+	// the rest. Orphans from exited threads are adopted along the way.
+	inline void Domain::scan(std::vector<Retired>& retired)
+	{
+		{
+			std::unique_lock<std::mutex> lock(orphans_mutex, std::try_to_lock);
+
+			if (lock.owns_lock() && !orphans.empty())
+			{
+				retired.insert(retired.end(), orphans.begin(), orphans.end());
+				orphans.clear();
+			}
+		}
+
+		std::vector<void*> hazards;
+		size_t used = records_used.load(std::memory_order_acquire);
+
+		for (size_t i = 0; i < used; i++)
+		{
+			for (const std::atomic<void*>& slot : records[i].slots)
+			{
+				void* pointer = slot.load(std::memory_order_seq_cst);
+				if (pointer)
+					hazards.push_back(pointer);
+			}
+		}
+
+		std::sort(hazards.begin(), hazards.end());
+
+		auto unprotected = std::partition(retired.begin(), retired.end(), [&](const Retired& node)
+		{
+			return std::binary_search(hazards.begin(), hazards.end(), node.pointer);
+		});
+
+		for (auto node = unprotected; node != retired.end(); ++node)
+			node->deleter(node->pointer);
+
+		retired.erase(unprotected, retired.end());
+	}
+
+	inline size_t Domain::get_records_used() const
+	{
+		return records_used.load(std::memory_order_relaxed);
+	}
+
+	inline ThreadState::ThreadState()
+		: record(domain().acquire())
+	{
+	}
+
+	inline ThreadState::~ThreadState()
+	{
+		for (std::atomic<void*>& slot : record->slots)
+			slot.store(nullptr, std::memory_order_seq_cst);
+
+		domain().scan(retired);
+
+		if (!retired.empty())
+			domain().abandon(retired);
+
+		domain().release(record);
+	}
+
+	inline std::atomic<void*>& ThreadState::slot(size_t index)
+	{
+		return record->slots[index];
+	}
+
+	// Scans once the retired list outgrows a multiple of the slots in use, so
+	// the cost of a scan is spread over that many retirements.
+	inline void ThreadState::retire(void* pointer, void (*deleter)(void*))
+	{
+		retired.push_back(Retired{ pointer, deleter });
+
+		if (retired.size() >= 2 * slots_per_thread * domain().get_records_used() + 64)
+			reclaim();
+	}
+
+	inline void ThreadState::reclaim()
+	{
+		domain().scan(retired);
+	}
+}
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "exceptions.h"
+#include "hazardpointer.h"
+
+// Michael-Scott queue: an unbounded linked queue where push links a node
+// after tail and pop advances head, each with a CAS instead of a lock. head
+// always points at a dummy node and the front element lives in the node
+// after it, so producers and consumers only meet when the queue is empty.
+// A thread that finds tail lagging behind the last node swings it forward
+// itself rather than waiting for the producer that linked it.
+//
+// Popped nodes are retired through hazard pointers, using both slots: one
+// for the node at head and one for its successor.
+//
+// A popped element's node becomes the new dummy, and a concurrent front()
+// may be reading the element there. By default front() and try_front() are
+// therefore not available, and pop moves the element out and destroys the
+// remains at once, so popping a std::string costs a move. With Peekable set
+// they are available, but pop has to copy the element out instead, and the
+// original stays in the dummy until the next pop retires it.
+template <typename T, bool Peekable = false>
+class LockFreeQueue
+{
+private:
+	static_assert(!Peekable || std::is_copy_constructible<T>::value, "A Peekable LockFreeQueue copies its elements");
+
+	struct Node
+	{
+		std::atomic<Node*> next;
+		bool               has_data;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		Node() : next(nullptr), has_data(false) { }
+
+		template <typename... Args>
+		explicit Node(std::in_place_t, Args&&... args) : next(nullptr), has_data(true)
+		{
+			::new (static_cast<void*>(storage)) T(std::forward<Args>(args)...);
+		}
+
+		~Node()
+		{
+			if (has_data)
+				data().~T();
+		}
+
+		T& data() { return *reinterpret_cast<T*>(storage); }
+	};
+
+	alignas(64) std::atomic<Node*> head;
+	alignas(64) std::atomic<Node*> tail;
+	alignas(64) std::atomic<size_t> size;
+
+public:
+	LockFreeQueue();
+	~LockFreeQueue();
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	void push(const T& element);
+	void push(T&& element);
+	T    pop();
+	bool try_pop(T& element);
+
+	// Peekable only.
+	T front() const;
+
+	// Returns std::nullopt where front would throw.
+	std::optional<T> try_front() const;
+
+	template <typename... Args>
+	void emplace(Args&&... args);
+
+	// Exact only while no push or pop is in flight; a push under way may
+	// already be counted, but the length never drops below zero.
+	size_t get_size() const;
+	size_t get_length() const;
+	bool   is_empty() const;
+};
+
+template <typename T, bool Peekable>
+LockFreeQueue<T, Peekable>::LockFreeQueue()
+	: size(0)
+{
+	Node* dummy = new Node();
+
+	head.store(dummy, std::memory_order_relaxed);
+	tail.store(dummy, std::memory_order_relaxed);
+}
+
+template <typename T, bool Peekable>
+LockFreeQueue<T, Peekable>::~LockFreeQueue()
+{
+	Node* node = head.load(std::memory_order_relaxed);
+
+	while (node)
+	{
+		Node* next = node->next.load(std::memory_order_relaxed);
+		delete node;
+		node = next;
+	}
+}
+
+template <typename T, bool Peekable>
+void LockFreeQueue<T, Peekable>::push(const T& element)
+{
+	emplace(element);
+}
+
+template <typename T, bool Peekable>
+void LockFreeQueue<T, Peekable>::push(T&& element)
+{
+	emplace(std::move(element));
+}
+
+template <typename T, bool Peekable>
+template <typename... Args>
+void LockFreeQueue<T, Peekable>::emplace(Args&&... args)
+{
+	Node* node = new Node(std::in_place, std::forward<Args>(args)...);
+
+	// Counted before the node is linked, so a pop's decrement can never
+	// overtake it and wrap the length below zero.
+	size.fetch_add(1, std::memory_order_relaxed);
+
+	hazard::Guard guard;
+
+	while (true)
+	{
+		Node* last = guard.protect(tail);
+		Node* next = last->next.load(std::memory_order_acquire);
+
+		if (last != tail.load(std::memory_order_acquire))
+			continue;
+
+		if (next)
+		{
+			tail.compare_exchange_weak(last, next, std::memory_order_release, std::memory_order_relaxed);
+			continue;
+		}
+
+		if (last->next.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed))
+		{
+			tail.compare_exchange_strong(last, node, std::memory_order_release, std::memory_order_relaxed);
+			break;
+		}
+	}
+}
+
+template <typename T, bool Peekable>
+T LockFreeQueue<T, Peekable>::pop()
+{
+	T element;
+
+	if (!try_pop(element))
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return element;
+}
+
+// The popped node becomes the new dummy. Without Peekable nothing else reads
+// its element, so it is moved out and destroyed here; otherwise front() may
+// be reading it at the same time and it is copied.
+template <typename T, bool Peekable>
+bool LockFreeQueue<T, Peekable>::try_pop(T& element)
+{
+	hazard::Guard first_guard(0);
+	hazard::Guard next_guard(1);
+
+	Node* first;
+	Node* next;
+
+	while (true)
+	{
+		first = first_guard.protect(head);
+		next = next_guard.protect(first->next);
+
+		// Once first is known to still be head, next cannot have been
+		// retired before it was protected.
+		if (first != head.load(std::memory_order_acquire))
+			continue;
+
+		if (!next)
+			return false;
+
+		Node* last = tail.load(std::memory_order_acquire);
+		if (first == last)
+		{
+			tail.compare_exchange_weak(last, next, std::memory_order_release, std::memory_order_relaxed);
+			continue;
+		}
+
+		if (head.compare_exchange_weak(first, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+			break;
+	}
+
+	size.fetch_sub(1, std::memory_order_relaxed);
+
+	if constexpr (Peekable)
+	{
+		element = next->data();
+	}
+	else
+	{
+		element = std::move(next->data());
+		next->data().~T();
+		next->has_data = false;
+	}
+
+	first_guard.reset();
+	hazard::retire(first);
+
+	return true;
+}
+
+template <typename T, bool Peekable>
+T LockFreeQueue<T, Peekable>::front() const
+{
+	static_assert(Peekable, "front() needs LockFreeQueue<T, true>");
+
+	hazard::Guard first_guard(0);
+	hazard::Guard next_guard(1);
+
+	while (true)
+	{
+		Node* first = first_guard.protect(head);
+		Node* next = next_guard.protect(first->next);
+
+		if (first != head.load(std::memory_order_acquire))
+			continue;
+
+		if (!next)
+			DS_THROW(std::out_of_range("Index out of range"));
+
+		return next->data();
+	}
+}
+
+template <typename T, bool Peekable>
+std::optional<T> LockFreeQueue<T, Peekable>::try_front() const
+{
+	static_assert(Peekable, "try_front() needs LockFreeQueue<T, true>");
+
+	hazard::Guard first_guard(0);
+	hazard::Guard next_guard(1);
+
+	while (true)
+	{
+		Node* first = first_guard.protect(head);
+		Node* next = next_guard.protect(first->next);
+
+		if (first != head.load(std::memory_order_acquire))
+			continue;
+
+		if (!next)
+			return std::nullopt;
+
+		return next->data();
+	}
+}
+
+template <typename T, bool Peekable>
+size_t LockFreeQueue<T, Peekable>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T, bool Peekable>
+size_t LockFreeQueue<T, Peekable>::get_length() const
+{
+	return size.load(std::memory_order_relaxed);
+}
+
+template <typename T, bool Peekable>
+bool LockFreeQueue<T, Peekable>::is_empty() const
+{
+	hazard::Guard guard;
+
+	return guard.protect(head)->next.load(std::memory_order_acquire) == nullptr;
+}
+
+#endif
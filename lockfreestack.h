@@ -0,0 +1,271 @@
+#ifndef LOCKFREESTACK_H
+#define LOCKFREESTACK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "exceptions.h"
+#include "hazardpointer.h"
+
+// Treiber stack: push and pop swing the top pointer with a CAS instead of
+// taking a lock. pop guards the node it reads with a hazard pointer, so a
+// node is never freed (or reused, which rules out ABA) while another thread
+// may still be looking at it.
+//
+// With an elimination array, a push or pop whose CAS on top fails tries a
+// random slot of the array before retrying: a push parks its node there
+// for a moment and a pop that finds it takes the node directly, so
+// colliding push/pop pairs cancel out without touching top at all.
+template <typename T>
+class LockFreeStack
+{
+private:
+	struct Node
+	{
+		T     data;
+		Node* next;
+
+		template <typename... Args>
+		Node(Args&&... args) : data(std::forward<Args>(args)...), next(nullptr) { }
+	};
+
+	// A slot holds nullptr, a pushed node on offer, or taken() once a pop has
+	// claimed that node and until its pusher notices.
+	struct alignas(64) EliminationSlot
+	{
+		std::atomic<Node*> offer{ nullptr };
+	};
+
+	static constexpr int elimination_spins = 128;
+
+	alignas(64) std::atomic<Node*> top;
+	alignas(64) std::atomic<size_t> size;
+
+	EliminationSlot* elimination;
+	size_t           elimination_width;
+
+public:
+	LockFreeStack();
+	explicit LockFreeStack(size_t elimination_width);
+	~LockFreeStack();
+
+	LockFreeStack(const LockFreeStack&) = delete;
+	LockFreeStack& operator=(const LockFreeStack&) = delete;
+
+	void push(const T& element);
+	void push(T&& element);
+	T    pop();
+	bool try_pop(T& element);
+
+	template <typename... Args>
+	void emplace(Args&&... args);
+
+	// Exact only while no push or pop is in flight; a push under way may
+	// already be counted, but the length never drops below zero.
+	size_t get_size() const;
+	size_t get_length() const;
+	bool   is_empty() const;
+
+private:
+	bool try_push_eliminated(Node* node);
+	bool try_pop_eliminated(T& element);
+
+	EliminationSlot& random_slot();
+
+	static Node* taken();
+};
+
+template <typename T>
+LockFreeStack<T>::LockFreeStack()
+	: top(nullptr), size(0), elimination(nullptr), elimination_width(0)
+{
+}
+
+template <typename T>
+LockFreeStack<T>::LockFreeStack(size_t elimination_width)
+	: top(nullptr), size(0), elimination(elimination_width ? new EliminationSlot[elimination_width] : nullptr),
+	  elimination_width(elimination_width)
+{
+}
+
+template <typename T>
+LockFreeStack<T>::~LockFreeStack()
+{
+	Node* node = top.load(std::memory_order_relaxed);
+
+	while (node)
+	{
+		Node* next = node->next;
+		delete node;
+		node = next;
+	}
+
+	delete[] elimination;
+}
+
+template <typename T>
+void LockFreeStack<T>::push(const T& element)
+{
+	emplace(element);
+}
+
+template <typename T>
+void LockFreeStack<T>::push(T&& element)
+{
+	emplace(std::move(element));
+}
+
+template <typename T>
+template <typename... Args>
+void LockFreeStack<T>::emplace(Args&&... args)
+{
+	Node* node = new Node(std::forward<Args>(args)...);
+	node->next = top.load(std::memory_order_relaxed);
+
+	// Counted before the node is visible, so a pop's decrement can never
+	// overtake it and wrap the length below zero.
+	size.fetch_add(1, std::memory_order_relaxed);
+
+	while (!top.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+	{
+		if (elimination && try_push_eliminated(node))
+		{
+			// The pop that took it never counted it.
+			size.fetch_sub(1, std::memory_order_relaxed);
+			return;
+		}
+
+		node->next = top.load(std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+T LockFreeStack<T>::pop()
+{
+	T element;
+
+	if (!try_pop(element))
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return element;
+}
+
+template <typename T>
+bool LockFreeStack<T>::try_pop(T& element)
+{
+	hazard::Guard guard;
+	Node* node;
+
+	while (true)
+	{
+		node = guard.protect(top);
+		if (!node)
+			return false;
+
+		if (top.compare_exchange_weak(node, node->next, std::memory_order_acquire, std::memory_order_relaxed))
+			break;
+
+		if (elimination && try_pop_eliminated(element))
+			return true;
+	}
+
+	size.fetch_sub(1, std::memory_order_relaxed);
+
+	element = std::move(node->data);
+
+	guard.reset();
+	hazard::retire(node);
+
+	return true;
+}
+
+template <typename T>
+typename LockFreeStack<T>::Node* LockFreeStack<T>::taken()
+{
+	// Never a real node: nodes are at least pointer-aligned.
+	return reinterpret_cast<Node*>(std::uintptr_t(1));
+}
+
+template <typename T>
+typename LockFreeStack<T>::EliminationSlot& LockFreeStack<T>::random_slot()
+{
+	thread_local std::uint32_t state = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(&state)) | 1;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return elimination[state % elimination_width];
+}
+
+// Parks node in a free slot and waits briefly for a pop to claim it. Returns
+// false, with node still owned by the caller, if no pop came.
+template <typename T>
+bool LockFreeStack<T>::try_push_eliminated(Node* node)
+{
+	EliminationSlot& slot = random_slot();
+
+	Node* expected = nullptr;
+	if (!slot.offer.compare_exchange_strong(expected, node, std::memory_order_release, std::memory_order_relaxed))
+		return false;
+
+	for (int spin = 0; spin < elimination_spins; spin++)
+	{
+		if (slot.offer.load(std::memory_order_acquire) != node)
+		{
+			slot.offer.store(nullptr, std::memory_order_release);
+			return true;
+		}
+	}
+
+	expected = node;
+	if (slot.offer.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel, std::memory_order_acquire))
+		return false;
+
+	// A pop claimed it while we were withdrawing.
+	slot.offer.store(nullptr, std::memory_order_release);
+	return true;
+}
+
+// Claims a node on offer in a random slot. The node was never linked into
+// the stack, so nothing else can reference it and it is freed right away.
+template <typename T>
+bool LockFreeStack<T>::try_pop_eliminated(T& element)
+{
+	EliminationSlot& slot = random_slot();
+
+	Node* node = slot.offer.load(std::memory_order_acquire);
+	if (!node || node == taken())
+		return false;
+
+	if (!slot.offer.compare_exchange_strong(node, taken(), std::memory_order_acq_rel, std::memory_order_relaxed))
+		return false;
+
+	element = std::move(node->data);
+	delete node;
+
+	return true;
+}
+
+template <typename T>
+size_t LockFreeStack<T>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T>
+size_t LockFreeStack<T>::get_length() const
+{
+	return size.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+bool LockFreeStack<T>::is_empty() const
+{
+	return top.load(std::memory_order_acquire) == nullptr;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef LOCKPOLICY_H
+#define LOCKPOLICY_H
+
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+
+// Locking policies for the containers. Each one models BasicLockable so the
+// containers can guard their state with std::lock_guard<Lock> regardless of
+// which policy they were instantiated with. Read-only operations go through
+// lock_shared/unlock_shared (std::shared_lock<Lock>); only SharedMutexLock
+// lets those run in parallel. Copying a policy copies its configuration,
+// never the state of the lock itself.
+
+// Single-threaded use: every lock/unlock compiles away.
+struct NoLock
+{
+	void lock() { }
+	void unlock() { }
+	void lock_shared() { }
+	void unlock_shared() { }
+};
+
+// Every operation is serialized on one std::mutex.
+struct MutexLock
+{
+	std::mutex mutex;
+
+	MutexLock() = default;
+	MutexLock(const MutexLock&) { }
+	MutexLock& operator=(const MutexLock&) { return *this; }
+
+	void lock() { mutex.lock(); }
+	void unlock() { mutex.unlock(); }
+	void lock_shared() { mutex.lock(); }
+	void unlock_shared() { mutex.unlock(); }
+};
+
+// Readers share the lock, writers take it exclusively. Suits read-heavy
+// workloads with rare appends.
+struct SharedMutexLock
+{
+	std::shared_mutex mutex;
+
+	SharedMutexLock() = default;
+	SharedMutexLock(const SharedMutexLock&) { }
+	SharedMutexLock& operator=(const SharedMutexLock&) { return *this; }
+
+	void lock() { mutex.lock(); }
+	void unlock() { mutex.unlock(); }
+	void lock_shared() { mutex.lock_shared(); }
+	void unlock_shared() { mutex.unlock_shared(); }
+};
+
+// Chooses between the two at construction time. Backs the constructors that
+// take an is_thread_safe flag; containers built without one are thread-safe.
+class RuntimeLock
+{
+private:
+	std::mutex mutex;
+	bool       is_thread_safe;
+
+public:
+	RuntimeLock() : is_thread_safe(true) { }
+	explicit RuntimeLock(bool is_thread_safe) : is_thread_safe(is_thread_safe) { }
+	RuntimeLock(const RuntimeLock& other) : is_thread_safe(other.is_thread_safe) { }
+	RuntimeLock& operator=(const RuntimeLock&) { return *this; }
+
+	void lock()
+	{
+		if (is_thread_safe)
+			mutex.lock();
+	}
+
+	void unlock()
+	{
+		if (is_thread_safe)
+			mutex.unlock();
+	}
+
+	void lock_shared() { lock(); }
+	void unlock_shared() { unlock(); }
+};
+
+// Locks the policies of two containers in address order so that concurrent
+// a.swap(b) and b.swap(a) cannot deadlock.
+template <typename Lock>
+class PairLockGuard
+{
+private:
+	Lock& first;
+	Lock& second;
+
+public:
+	PairLockGuard(Lock& a, Lock& b)
+		: first(std::less<Lock*>()(&a, &b) ? a : b), second(std::less<Lock*>()(&a, &b) ? b : a)
+	{
+		first.lock();
+		second.lock();
+	}
+
+	~PairLockGuard()
+	{
+		second.unlock();
+		first.unlock();
+	}
+
+	PairLockGuard(const PairLockGuard&) = delete;
+	PairLockGuard& operator=(const PairLockGuard&) = delete;
+};
+
+// Keeps the Container(bool is_thread_safe) constructors from competing with
+// Container(size_t capacity) for integer arguments.
+template <typename B>
+using enable_if_bool = std::enable_if_t<std::is_same<B, bool>::value, int>;
+
+#endif
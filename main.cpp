@@ -1,13 +1,127 @@
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 #include "vector.h"
 #include "stack.h"
 #include "queue.h"
 #include "doublylinkedlist.h"
+#include "concurrentvector.h"
+#include "parallel.h"
+#include "lockfreestack.h"
+#include "workstealingdeque.h"
+#include "mpmcqueue.h"
+#include "spscqueue.h"
+#include "lockfreequeue.h"
+#include "twolockqueue.h"
+#include "smallvector.h"
+#include "staticvector.h"
+#include "staticstack.h"
 
 void test_vector();
 void test_stack();
 void test_queue();
 void test_doublylinkedlist();
+void test_concurrentvector();
+void test_parallel();
+void test_lockfreestack();
+void test_stack_overflow();
+void test_workstealingdeque();
+void test_mpmcqueue();
+void test_spscqueue();
+void test_lockfreequeue();
+void test_twolockqueue();
+void test_queue_waiting();
+void test_vector_scans();
+void test_queue_nodes();
+void test_list_slabs();
+void test_smallvector();
+void test_static_containers();
+void test_try_accessors();
+
+int failures = 0;
+
+void check(bool condition, const char* description)
+{
+    std::cout << (condition ? "ok: " : "FAILED: ") << description << '\n';
+
+    if (!condition)
+        failures++;
+}
+
+// Counts live instances, so a test can tell whether a container freed every
+// element it built.
+struct Tracked
+{
+    static std::atomic<int> live;
+
+    long long value;
+
+    Tracked(long long value = 0) : value(value) { live++; }
+    Tracked(const Tracked& other) noexcept : value(other.value) { live++; }
+    Tracked& operator=(const Tracked&) = default;
+    ~Tracked() { live--; }
+};
+
+std::atomic<int> Tracked::live{ 0 };
+
+// Runs producers that each push 1..per_thread and consumers that pop until
+// every element is accounted for, and returns the sum of what was popped.
+// push and pop report failure (full or empty) by returning false.
+template <typename Push, typename Pop>
+long long transfer(int producers, int consumers, int per_thread, Push push, Pop pop)
+{
+    std::atomic<long long> remaining{ static_cast<long long>(producers) * per_thread };
+    std::atomic<long long> sum{ 0 };
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (long long i = 1; i <= per_thread; i++)
+                while (!push(i))
+                    std::this_thread::yield();
+        });
+    }
+
+    for (int c = 0; c < consumers; c++)
+    {
+        threads.emplace_back([&]()
+        {
+            long long element;
+
+            while (remaining.load() > 0)
+            {
+                if (pop(element))
+                {
+                    sum += element;
+                    remaining--;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return sum;
+}
+
+// What transfer returns when nothing is lost or duplicated.
+long long transfer_total(int producers, int per_thread)
+{
+    return static_cast<long long>(producers) * per_thread * (per_thread + 1) / 2;
+}
 
 int main() 
 {
@@ -15,8 +129,24 @@ int main()
     test_stack();
     test_queue();
     test_doublylinkedlist();
+    test_concurrentvector();
+    test_parallel();
+    test_lockfreestack();
+    test_stack_overflow();
+    test_workstealingdeque();
+    test_mpmcqueue();
+    test_spscqueue();
+    test_lockfreequeue();
+    test_twolockqueue();
+    test_queue_waiting();
+    test_vector_scans();
+    test_queue_nodes();
+    test_list_slabs();
+    test_smallvector();
+    test_static_containers();
+    test_try_accessors();
 
-    return 0;
+    return failures ? 1 : 0;
 }
 
 void test_vector()
@@ -133,4 +263,1120 @@ void test_doublylinkedlist()
     std::cout << "Size: " << list.get_size() << '\n';
     std::cout << "Length: " << list.get_length() << '\n';
     std::cout << "---------------------------------\n";
-}
\ No newline at end of file
+}
+
+#ifndef DS_NO_EXCEPTIONS
+// Throws when built from a negative value.
+struct Picky
+{
+    int value;
+
+    Picky(int value) : value(value)
+    {
+        if (value < 0)
+            throw std::runtime_error("negative");
+    }
+};
+#endif
+
+void test_concurrentvector()
+{
+    std::cout << "\n---------------------------------\nConcurrent Vector\n";
+
+    const int threads = 4;
+    const int per_thread = 10000;
+
+    ConcurrentVector<int> vec;
+    std::vector<std::thread> writers;
+
+    for (int t = 0; t < threads; t++)
+        writers.emplace_back([&vec, t]() { for (int i = 1; i <= per_thread; i++) vec.push_back(t * per_thread + i); });
+
+    for (std::thread& writer : writers)
+        writer.join();
+
+    long long sum = 0;
+    for (size_t i = 0; i < vec.get_length(); i++)
+        sum += vec[i];
+
+    long long total = static_cast<long long>(threads) * per_thread;
+    check(vec.get_length() == static_cast<size_t>(total), "every push_back is counted");
+    check(sum == total * (total + 1) / 2, "every pushed value is stored once");
+
+#ifndef DS_NO_EXCEPTIONS
+    ConcurrentVector<Picky> picky;
+    picky.emplace_back(1);
+
+    bool threw = false;
+    try { picky.emplace_back(-1); } catch (const std::runtime_error&) { threw = true; }
+
+    picky.emplace_back(3);
+
+    check(threw, "a throwing constructor propagates out of emplace_back");
+    check(picky.get_length() == 3, "the failed slot still counts in the length");
+    check(!picky.try_at(1), "try_at returns nullopt for the failed slot");
+    check(picky.try_at(2) && picky.try_at(2)->value == 3, "slots after the failed one are readable");
+
+    threw = false;
+    try { picky.at(1); } catch (const std::runtime_error&) { threw = true; }
+    check(threw, "at throws for the failed slot instead of waiting on it");
+    check(!picky.try_at(3), "try_at returns nullopt past the end");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_parallel()
+{
+    std::cout << "\n---------------------------------\nParallel\n";
+
+    ThreadPool pool(4);
+    std::pmr::monotonic_buffer_resource resource;
+    pmr::Vector<int, MutexLock> vec(&resource);
+
+    for (int i = 0; i < 10000; i++)
+        vec.push_back((i * 7919) % 10000);
+
+    parallel_sort(vec, pool);
+
+    bool sorted = true;
+    for (int i = 0; i < 10000; i++)
+        sorted = sorted && vec[i] == i;
+
+    check(sorted, "parallel_sort sorts a pmr::Vector");
+
+    parallel_transform(vec, pool, [](int element) { return element * 2; });
+    parallel_for_each(vec, pool, [](int& element) { element /= 2; });
+
+    check(parallel_reduce(vec, pool, 0, [](int a, int b) { return a + b; }) == 49995000, "parallel_reduce sums a pmr::Vector");
+
+    Vector<int, MutexLock> large;
+    for (int i = 0; i < 1000; i++)
+        large.push_back(2000000000);
+
+    long long total = parallel_reduce(large, pool, 0LL, [](long long a, long long b) { return a + b; });
+    check(total == 2000000000000LL, "parallel_reduce accumulates in the type of init");
+
+#ifndef DS_NO_EXCEPTIONS
+    Vector<int, MutexLock> guarded;
+    for (int i = 0; i < 4000; i++)
+        guarded.push_back(i);
+
+    bool threw = false;
+    try
+    {
+        parallel_for_each(guarded, pool, [](int& element)
+        {
+            if (element == 0)
+                throw std::runtime_error("first chunk fails");
+
+            std::this_thread::sleep_for(std::chrono::microseconds(5));
+            element++;
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    long long after_throw = guarded.sum();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    check(threw && guarded.sum() == after_throw, "no chunk is still running once parallel_for_each rethrows");
+
+    std::atomic<int> comparisons{ 0 };
+    threw = false;
+
+    try
+    {
+        parallel_sort(guarded, pool, [&comparisons](int a, int b)
+        {
+            if (++comparisons == 20000)
+                throw std::runtime_error("comparison fails");
+
+            return a > b;
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    // std::sort only promises a valid, unspecified order after a throw, so
+    // just make sure nothing is still merging.
+    long long after_sort = guarded.sum();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    check(threw && guarded.get_length() == 4000 && guarded.sum() == after_sort, "no merge is still running once parallel_sort rethrows");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_lockfreestack()
+{
+    std::cout << "\n---------------------------------\nLock-Free Stack\n";
+
+    LockFreeStack<int> empty;
+    int element = 0;
+
+    check(!empty.try_pop(element) && empty.is_empty(), "try_pop fails on an empty stack");
+
+    empty.push(1);
+    empty.push(2);
+    check(empty.try_pop(element) && element == 2, "pop returns the last push");
+    check(empty.get_length() == 1, "length follows push and pop");
+
+    {
+        LockFreeStack<Tracked> stack;
+
+        std::atomic<bool> transferring{ true };
+        size_t longest = 0;
+        std::thread sampler([&]()
+        {
+            while (transferring)
+            {
+                longest = std::max(longest, stack.get_length());
+                std::this_thread::yield();
+            }
+        });
+
+        long long sum = transfer(4, 4, 20000,
+            [&](long long i) { stack.push(Tracked(i)); return true; },
+            [&](long long& i) { Tracked popped; if (!stack.try_pop(popped)) return false; i = popped.value; return true; });
+
+        transferring = false;
+        sampler.join();
+
+        check(sum == transfer_total(4, 20000), "concurrent push/pop neither loses nor duplicates elements");
+        check(longest <= 4 * 20000, "the length never wraps below zero under contention");
+        check(stack.is_empty(), "the stack is empty once everything is popped");
+
+        for (int i = 0; i < 100; i++)
+            stack.push(Tracked(i));
+    }
+
+    {
+        LockFreeStack<Tracked> stack(8);
+
+        long long sum = transfer(4, 4, 20000,
+            [&](long long i) { stack.push(Tracked(i)); return true; },
+            [&](long long& i) { Tracked popped; if (!stack.try_pop(popped)) return false; i = popped.value; return true; });
+
+        check(sum == transfer_total(4, 20000), "elimination neither loses nor duplicates elements");
+        check(stack.is_empty() && stack.get_length() == 0, "eliminated pairs leave the length balanced");
+    }
+
+    // Nodes retired by the exited threads are freed by the next scan.
+    hazard::thread_state().reclaim();
+    check(Tracked::live == 0, "every node is freed after the stack and its threads are gone");
+
+#ifndef DS_NO_EXCEPTIONS
+    bool threw = false;
+    try { LockFreeStack<int>().pop(); } catch (const std::out_of_range&) { threw = true; }
+    check(threw, "pop throws on an empty stack");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_stack_overflow()
+{
+    std::cout << "\n---------------------------------\nStack Overflow Policies\n";
+
+    Stack<int, MutexLock> grow(2, StackOverflow::Grow);
+    for (int i = 0; i < 100; i++)
+        grow.push(i);
+
+    check(grow.get_length() == 100 && grow.get_capacity() >= 100, "Grow reallocates past the initial capacity");
+    check(grow.at(0) == 0 && grow.at(99) == 99, "Grow keeps the elements in order");
+
+    Stack<int, MutexLock> chunked(4, StackOverflow::GrowChunked);
+    for (int i = 0; i < 10; i++)
+        chunked.push(i);
+
+    bool in_order = true;
+    for (int i = 0; i < 10; i++)
+        in_order = in_order && chunked.at(i) == i;
+
+    check(in_order && chunked.get_capacity() == 12, "GrowChunked links chunks of the initial capacity");
+
+    while (chunked.try_pop()) { }
+    chunked.push(7);
+    check(chunked.get_length() == 1 && chunked.top() == 7, "GrowChunked is reusable after being emptied");
+
+    Stack<int, MutexLock> reject(3, StackOverflow::Reject);
+    bool accepted = reject.push(1) && reject.push(2) && reject.push(3);
+
+    check(accepted && !reject.push(4), "Reject turns an element away when full");
+    check(reject.get_length() == 3 && reject.top() == 3, "Reject leaves the stack unchanged");
+
+    Stack<int, MutexLock> ring(3, StackOverflow::OverwriteOldest);
+    for (int i = 1; i <= 5; i++)
+        ring.push(i);
+
+    check(ring.get_length() == 3 && ring.at(0) == 3 && ring.top() == 5, "OverwriteOldest drops the bottom elements");
+
+    Stack<int, MutexLock> block(1, StackOverflow::Block);
+    block.push(1);
+
+    std::atomic<bool> pushed{ false };
+    std::thread pusher([&]() { block.push(2); pushed = true; });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    check(!pushed && block.get_length() == 1, "Block waits while the stack is full");
+
+    block.pop();
+    pusher.join();
+    check(pushed && block.top() == 2, "Block completes once a pop makes room");
+
+    Stack<long long, MutexLock> bounded(8, StackOverflow::Block);
+    long long sum = transfer(4, 4, 5000,
+        [&](long long i) { return bounded.push(i); },
+        [&](long long& i) { std::optional<long long> popped = bounded.try_pop(); if (popped) i = *popped; return popped.has_value(); });
+
+    check(sum == transfer_total(4, 5000), "Block neither loses nor duplicates elements under contention");
+
+    Stack<int, MutexLock> moved_to(std::move(block));
+    Stack<int, MutexLock> rejected_to(std::move(reject));
+
+    check(block.push(3) && block.get_length() == 1, "a moved-from Block stack accepts a push");
+    check(reject.push(3) && reject.get_capacity() == 3, "a moved-from Reject stack keeps its bound");
+
+#ifndef DS_NO_EXCEPTIONS
+    bool threw = false;
+    try { Stack<int> invalid(0, StackOverflow::Block); } catch (const std::invalid_argument&) { threw = true; }
+    check(threw, "Block rejects a capacity of zero");
+
+    threw = false;
+    try { Stack<int> invalid(0, StackOverflow::OverwriteOldest); } catch (const std::invalid_argument&) { threw = true; }
+    check(threw, "OverwriteOldest rejects a capacity of zero");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_workstealingdeque()
+{
+    std::cout << "\n---------------------------------\nWork-Stealing Deque\n";
+
+    WorkStealingDeque<long long> deque(4);
+    long long element = 0;
+
+    check(!deque.try_pop(element) && !deque.try_steal(element), "pop and steal fail on an empty deque");
+
+    for (long long i = 1; i <= 10; i++)
+        deque.push(i);
+
+    check(deque.get_length() == 10 && deque.get_capacity() >= 10, "push grows the buffer");
+    check(deque.try_pop(element) && element == 10, "the owner pops the newest element");
+    check(deque.try_steal(element) && element == 1, "a thief steals the oldest element");
+
+    while (deque.try_pop(element)) { }
+
+    const int per_thread = 50000;
+    const int thieves = 3;
+
+    std::atomic<bool> done{ false };
+    std::atomic<long long> stolen{ 0 };
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < thieves; t++)
+    {
+        threads.emplace_back([&]()
+        {
+            long long taken;
+
+            while (!done || !deque.is_empty())
+            {
+                if (deque.try_steal(taken))
+                    stolen += taken;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    long long popped = 0;
+    for (long long i = 1; i <= per_thread; i++)
+    {
+        deque.push(i);
+
+        if (i % 3 == 0 && deque.try_pop(element))
+            popped += element;
+    }
+
+    while (deque.try_pop(element))
+        popped += element;
+
+    done = true;
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    check(popped + stolen == transfer_total(1, per_thread), "every element is either popped or stolen exactly once");
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_mpmcqueue()
+{
+    std::cout << "\n---------------------------------\nMPMC Queue\n";
+
+    MPMCQueue<int> queue(3);
+    int element = 0;
+
+    check(queue.get_capacity() == 4, "capacity rounds up to a power of two");
+    check(!queue.try_pop(element), "try_pop fails on an empty queue");
+
+    bool accepted = true;
+    for (int i = 0; i < 4; i++)
+        accepted = accepted && queue.try_push(i);
+
+    check(accepted && !queue.try_push(4), "try_push fails on a full queue");
+
+    bool in_order = true;
+    for (int lap = 0; lap < 100; lap++)
+    {
+        for (int i = 0; i < 4; i++)
+            in_order = in_order && queue.try_pop(element) && element == lap * 4 + i;
+
+        for (int i = 0; i < 4; i++)
+            queue.try_push((lap + 1) * 4 + i);
+    }
+
+    check(in_order, "elements stay in FIFO order across many laps of the ring");
+
+    {
+        MPMCQueue<Tracked> small(8);
+
+        long long sum = transfer(4, 4, 20000,
+            [&](long long i) { return small.try_push(Tracked(i)); },
+            [&](long long& i) { Tracked popped; if (!small.try_pop(popped)) return false; i = popped.value; return true; });
+
+        check(sum == transfer_total(4, 20000), "concurrent push/pop on a small ring neither loses nor duplicates elements");
+
+        for (int i = 0; i < 5; i++)
+            small.try_push(Tracked(i));
+    }
+
+    check(Tracked::live == 0, "the destructor frees the elements left in the queue");
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_spscqueue()
+{
+    std::cout << "\n---------------------------------\nSPSC Queue\n";
+
+    SPSCQueue<int> queue(4);
+    int element = 0;
+
+    check(!queue.try_pop(element), "try_pop fails on an empty queue");
+
+    int values[6] = { 0, 1, 2, 3, 4, 5 };
+    check(queue.push_bulk(values, values + 6) == 4 && !queue.try_push(6), "push_bulk stops at capacity");
+
+    int out[6] = {};
+    check(queue.pop_bulk(out, 3) == 3 && out[2] == 2 && queue.get_length() == 1, "pop_bulk takes at most max_count");
+
+    bool in_order = queue.try_pop(element) && element == 3;
+    for (int i = 0; i < 1000; i++)
+        in_order = in_order && queue.try_push(i) && queue.try_push(i + 1) && queue.try_pop(element) && element == i &&
+                   queue.try_pop(element) && element == i + 1;
+
+    check(in_order && queue.is_empty(), "elements stay in FIFO order across many laps of the ring");
+
+    const long long count = 200000;
+    SPSCQueue<long long> pipe(64);
+    bool ordered = true;
+    long long sum = 0;
+
+    std::thread consumer([&]()
+    {
+        long long expected = 1;
+        long long batch[16];
+
+        while (expected <= count)
+        {
+            size_t popped = pipe.pop_bulk(batch, 16);
+
+            for (size_t i = 0; i < popped; i++, expected++)
+            {
+                ordered = ordered && batch[i] == expected;
+                sum += batch[i];
+            }
+
+            if (!popped)
+                std::this_thread::yield();
+        }
+    });
+
+    for (long long i = 1; i <= count; i++)
+        while (!pipe.try_push(i))
+            std::this_thread::yield();
+
+    consumer.join();
+
+    check(ordered && sum == count * (count + 1) / 2, "one producer and one consumer see every element once, in order");
+
+    std::cout << "---------------------------------\n";
+}
+
+// Counts copies, so a test can tell whether a container moved its elements.
+struct CopyCounted
+{
+    static int copies;
+
+    std::string text;
+
+    CopyCounted(std::string text = "") : text(std::move(text)) { }
+    CopyCounted(const CopyCounted& other) : text(other.text) { copies++; }
+    CopyCounted(CopyCounted&&) = default;
+
+    CopyCounted& operator=(const CopyCounted& other) { text = other.text; copies++; return *this; }
+    CopyCounted& operator=(CopyCounted&&) = default;
+};
+
+int CopyCounted::copies = 0;
+
+void test_lockfreequeue()
+{
+    std::cout << "\n---------------------------------\nLock-Free Queue\n";
+
+    LockFreeQueue<int> queue;
+    int element = 0;
+
+    check(!queue.try_pop(element) && queue.is_empty(), "try_pop fails on an empty queue");
+
+    for (int i = 0; i < 5; i++)
+        queue.push(i);
+
+    bool in_order = true;
+    for (int i = 0; i < 5; i++)
+        in_order = in_order && queue.try_pop(element) && element == i;
+
+    check(in_order && queue.is_empty(), "elements come out in FIFO order");
+
+    LockFreeQueue<CopyCounted> strings;
+    strings.push(CopyCounted("a string long enough to live on the heap"));
+    CopyCounted::copies = 0;
+
+    CopyCounted popped = strings.pop();
+    check(CopyCounted::copies == 0 && popped.text.size() == 40, "pop moves the element out");
+
+    LockFreeQueue<CopyCounted, true> peekable;
+    peekable.push(CopyCounted("front"));
+    check(peekable.front().text == "front" && peekable.try_front(), "a Peekable queue provides front");
+    check(peekable.pop().text == "front" && !peekable.try_front(), "try_front returns nullopt once drained");
+
+    LockFreeQueue<std::unique_ptr<int>> owners;
+    owners.push(std::make_unique<int>(7));
+    check(*owners.pop() == 7, "move-only elements can be queued");
+
+    {
+        LockFreeQueue<Tracked> shared;
+
+        std::atomic<bool> transferring{ true };
+        size_t longest = 0;
+        std::thread sampler([&]()
+        {
+            while (transferring)
+            {
+                longest = std::max(longest, shared.get_length());
+                std::this_thread::yield();
+            }
+        });
+
+        long long sum = transfer(4, 4, 20000,
+            [&](long long i) { shared.push(Tracked(i)); return true; },
+            [&](long long& i) { Tracked popped; if (!shared.try_pop(popped)) return false; i = popped.value; return true; });
+
+        transferring = false;
+        sampler.join();
+
+        check(sum == transfer_total(4, 20000), "concurrent push/pop neither loses nor duplicates elements");
+        check(longest <= 4 * 20000, "the length never wraps below zero under contention");
+        check(shared.is_empty() && shared.get_length() == 0, "the queue is empty once everything is popped");
+
+        for (int i = 0; i < 100; i++)
+            shared.push(Tracked(i));
+    }
+
+    hazard::thread_state().reclaim();
+    check(Tracked::live == 0, "every node is freed after the queue and its threads are gone");
+
+#ifndef DS_NO_EXCEPTIONS
+    bool threw = false;
+    try { queue.pop(); } catch (const std::out_of_range&) { threw = true; }
+    check(threw, "pop throws on an empty queue");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_twolockqueue()
+{
+    std::cout << "\n---------------------------------\nTwo-Lock Queue\n";
+
+    TwoLockQueue<std::string, MutexLock> queue;
+    std::string element;
+
+    check(!queue.try_pop(element) && !queue.try_front() && queue.is_empty(), "try_pop and try_front fail on an empty queue");
+
+    queue.push("first");
+    queue.emplace(3, 'x');
+    check(queue.front() == "first" && queue.get_length() == 2, "front shows the oldest element");
+    check(queue.pop() == "first" && queue.try_pop(element) && element == "xxx", "elements come out in FIFO order");
+    check(queue.is_empty(), "the queue is empty once everything is popped");
+
+    {
+        TwoLockQueue<Tracked, MutexLock> shared;
+
+        long long sum = transfer(4, 4, 20000,
+            [&](long long i) { shared.push(Tracked(i)); return true; },
+            [&](long long& i) { Tracked popped; if (!shared.try_pop(popped)) return false; i = popped.value; return true; });
+
+        check(sum == transfer_total(4, 20000), "concurrent push/pop neither loses nor duplicates elements");
+
+        for (int i = 0; i < 5; i++)
+            shared.push(Tracked(i));
+    }
+
+    check(Tracked::live == 0, "the destructor frees the elements left in the queue");
+
+#ifndef DS_NO_EXCEPTIONS
+    bool threw = false;
+    try { queue.pop(); } catch (const std::out_of_range&) { threw = true; }
+    check(threw, "pop throws on an empty queue");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_queue_waiting()
+{
+    std::cout << "\n---------------------------------\nQueue Waiting\n";
+
+    Queue<int, MutexLock> queue;
+    int element = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    bool popped = queue.wait_pop_for(element, std::chrono::milliseconds(50));
+    auto waited = std::chrono::steady_clock::now() - start;
+
+    check(!popped && waited >= std::chrono::milliseconds(50), "wait_pop_for times out on an empty queue");
+
+    std::thread producer([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.push(42);
+    });
+
+    check(queue.wait_pop(element) && element == 42, "wait_pop returns an element pushed while it waits");
+    producer.join();
+
+    std::atomic<int> woken{ 0 };
+    std::vector<std::thread> consumers;
+
+    for (int c = 0; c < 3; c++)
+        consumers.emplace_back([&]() { int unused; if (!queue.wait_pop(unused)) woken++; });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.close();
+
+    for (std::thread& consumer : consumers)
+        consumer.join();
+
+    check(woken == 3, "close wakes every waiting consumer");
+    check(queue.is_closed() && !queue.wait_pop_for(element, std::chrono::seconds(10)), "waiting on a closed, empty queue returns at once");
+
+    Queue<long long, MutexLock> shared;
+    std::atomic<long long> sum{ 0 };
+    std::vector<std::thread> threads;
+
+    for (int c = 0; c < 4; c++)
+    {
+        threads.emplace_back([&]()
+        {
+            long long value;
+            while (shared.wait_pop(value))
+                sum += value;
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; p++)
+        producers.emplace_back([&]() { for (long long i = 1; i <= 20000; i++) shared.push(i); });
+
+    for (std::thread& thread : producers)
+        thread.join();
+
+    // Consumers drain what is left before seeing the close.
+    shared.close();
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    check(sum == transfer_total(4, 20000), "wait_pop consumers drain every element before a close ends them");
+
+    std::cout << "---------------------------------\n";
+}
+
+// Checks the bulk scans against plain loops for every length from 0 to 33,
+// so the main loop and the scalar tail of each kernel both run. Values are
+// small whole numbers, so float and double sums are exact in any order.
+template <typename T>
+bool scans_match_loops()
+{
+    bool matches = true;
+
+    for (int length = 0; length <= 33; length++)
+    {
+        Vector<T, NoLock> vec;
+        T expected_sum = 0;
+        T expected_min = 0;
+        T expected_max = 0;
+
+        for (int i = 0; i < length; i++)
+        {
+            T value = static_cast<T>((i * 7) % 11 - 5);
+            vec.push_back(value);
+
+            expected_sum += value;
+            expected_min = i == 0 || value < expected_min ? value : expected_min;
+            expected_max = i == 0 || value > expected_max ? value : expected_max;
+        }
+
+        int expected_find = -1;
+        size_t expected_count = 0;
+        T last = length ? vec[length - 1] : T(0);
+
+        for (int i = 0; i < length; i++)
+        {
+            if (vec[i] == last && expected_find < 0)
+                expected_find = i;
+
+            if (vec[i] == last)
+                expected_count++;
+        }
+
+        matches = matches && vec.sum() == expected_sum && vec.count(last) == expected_count &&
+                  vec.find(last) == expected_find && vec.find(T(100)) == -1 && vec.count(T(100)) == 0;
+
+        if (length)
+            matches = matches && vec.min() == expected_min && vec.max() == expected_max;
+
+#ifdef DS_SIMD_X86
+        // The dispatch only reaches the best level the CPU has, so run the
+        // SSE4.1 kernels directly as well.
+        using SSE41Ops = typename simd::ops_for<simd::sse41_set, T>::type;
+
+        if (simd::level() != simd::Level::Scalar)
+        {
+            size_t expected_position = expected_find < 0 ? length : expected_find;
+
+            vec.access([&](const T* data, size_t)
+            {
+                matches = matches && simd::sse41::sum<SSE41Ops>(data, length) == expected_sum &&
+                          simd::sse41::count<SSE41Ops>(data, length, last) == expected_count &&
+                          simd::sse41::find<SSE41Ops>(data, length, last) == expected_position;
+
+                if (length)
+                    matches = matches && simd::sse41::min<SSE41Ops>(data, length) == expected_min &&
+                              simd::sse41::max<SSE41Ops>(data, length) == expected_max;
+            });
+        }
+#endif
+
+        vec.fill(T(3));
+
+        for (int i = 0; i < length; i++)
+            matches = matches && vec[i] == T(3);
+    }
+
+    return matches;
+}
+
+void test_vector_scans()
+{
+    std::cout << "\n---------------------------------\nVector Scans\n";
+
+    check(scans_match_loops<int>(), "int scans match plain loops for lengths 0-33");
+    check(scans_match_loops<float>(), "float scans match plain loops for lengths 0-33");
+    check(scans_match_loops<double>(), "double scans match plain loops for lengths 0-33");
+
+    Vector<int, NoLock> empty;
+    check(empty.sum() == 0 && empty.find(1) == -1 && empty.count(1) == 0, "scans over an empty vector");
+
+#ifndef DS_NO_EXCEPTIONS
+    bool threw = false;
+    try { empty.min(); } catch (const std::out_of_range&) { threw = true; }
+    check(threw, "min throws on an empty vector");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+// Counts the blocks it has handed out and not yet taken back.
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    long long outstanding = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        outstanding++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+    {
+        outstanding--;
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+// Pops count elements and checks they are first, first + 1, ...
+template <typename Q>
+bool pops_in_order(Q& queue, int first, int count)
+{
+    bool in_order = true;
+    int element = 0;
+
+    for (int i = 0; i < count; i++)
+        in_order = in_order && queue.try_pop(element) && element == first + i;
+
+    return in_order;
+}
+
+void test_queue_nodes()
+{
+    std::cout << "\n---------------------------------\nQueue Node Recycling\n";
+
+    Queue<int, MutexLock> queue;
+    queue.reserve_nodes(8);
+    check(queue.get_pooled_nodes() == 8 && queue.get_node_pool_limit() == 8, "reserve_nodes fills the freelist");
+
+    for (int i = 0; i < 5; i++)
+        queue.push(i);
+
+    check(queue.get_pooled_nodes() == 3, "pushes take nodes from the freelist");
+    check(pops_in_order(queue, 0, 5) && queue.get_pooled_nodes() == 8, "pops return nodes to the freelist");
+
+    bool in_order = true;
+    for (int round = 0; round < 50; round++)
+    {
+        for (int i = 0; i < 12; i++)
+            queue.push(round * 12 + i);
+
+        in_order = in_order && pops_in_order(queue, round * 12, 12);
+    }
+
+    check(in_order && queue.get_pooled_nodes() == 8, "recycled nodes keep FIFO order and the pool stays at its limit");
+
+    queue.set_node_pool_limit(2);
+    check(queue.get_pooled_nodes() == 2, "lowering the limit trims the freelist");
+
+    int values[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    queue.push_bulk(values, values + 10);
+    check(queue.get_length() == 10 && queue.get_pooled_nodes() == 0, "push_bulk links every element and uses the freelist");
+
+    int out[10] = {};
+    check(queue.pop_bulk(out, 4) == 4 && out[0] == 0 && out[3] == 3, "pop_bulk takes at most max_count, in order");
+    check(queue.pop_bulk(out, 100) == 6 && out[5] == 9 && queue.get_length() == 0, "pop_bulk stops when the queue is empty");
+    check(queue.pop_bulk(out, 4) == 0 && queue.get_pooled_nodes() == 2, "pop_bulk on an empty queue returns 0");
+
+    Queue<int, MutexLock> cached;
+    cached.set_thread_cache(true);
+
+    in_order = true;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 100; i++)
+            cached.push(round * 100 + i);
+
+        in_order = in_order && pops_in_order(cached, round * 100, 100);
+    }
+
+    check(in_order && cached.get_length() == 0, "the thread cache keeps FIFO order");
+
+    CountingResource first_resource;
+    CountingResource second_resource;
+
+    {
+        pmr::Queue<std::string, MutexLock> source(&first_resource);
+        pmr::Queue<std::string, MutexLock> target(&second_resource);
+
+        source.reserve_nodes(4);
+        for (int i = 0; i < 6; i++)
+            source.push(std::to_string(i));
+
+        target.push("replaced");
+        target = std::move(source);
+
+        check(target.get_length() == 6 && target.front() == "0" && target.back() == "5", "move assignment across resources moves every element");
+        check(target.get_allocator().resource() == &second_resource, "the target keeps its own resource");
+        check(second_resource.outstanding == 6, "the target's nodes come from its own resource");
+
+        source.push("again");
+        check(source.get_length() == 1 && source.front() == "again", "the moved-from queue can be reused");
+    }
+
+    check(first_resource.outstanding == 0 && second_resource.outstanding == 0, "both resources get every node back");
+
+    std::cout << "---------------------------------\n";
+}
+
+// Compares a list with a reference deque, element by element.
+template <typename List>
+bool list_matches(const List& list, const std::deque<int>& expected)
+{
+    std::vector<int> elements;
+    list.for_each([&](const int& element) { elements.push_back(element); });
+
+    return elements.size() == expected.size() && std::equal(elements.begin(), elements.end(), expected.begin()) &&
+           (expected.empty() || (list.get_head() == expected.front() && list.get_tail() == expected.back()));
+}
+
+void test_list_slabs()
+{
+    std::cout << "\n---------------------------------\nDoubly Linked List Slabs\n";
+
+    DoublyLinkedList<int, MutexLock> list;
+    std::deque<int> expected;
+
+    list.use_slab_storage(4);
+
+    for (int i = 0; i < 200; i++)
+    {
+        switch (i % 5)
+        {
+        case 0: case 1: list.push_back(i); expected.push_back(i); break;
+        case 2:         list.push_front(i); expected.push_front(i); break;
+        case 3:         list.pop_front(); expected.pop_front(); break;
+        case 4:         list.pop_back(); expected.pop_back(); break;
+        }
+    }
+
+    check(list.uses_slab_storage() && list_matches(list, expected), "slab storage keeps order under mixed pushes and pops at both ends");
+
+    list.compact();
+    check(list_matches(list, expected), "compact keeps order, head and tail");
+
+    list.push_front(-1);
+    list.push_back(1000);
+    expected.push_front(-1);
+    expected.push_back(1000);
+    check(list_matches(list, expected), "a compacted list accepts pushes at both ends");
+
+    DoublyLinkedList<int, MutexLock> copy = list.clone();
+    copy.pop_front();
+    check(list_matches(list, expected) && copy.get_length() == expected.size() - 1, "clone of a slab list is independent");
+
+    DoublyLinkedList<int, MutexLock> moved(std::move(list));
+    check(list_matches(moved, expected), "moving a slab list keeps its elements");
+
+    list.push_back(7);
+    list.push_front(6);
+    check(list_matches(list, { 6, 7 }), "a moved-from slab list can be used again");
+
+    DoublyLinkedList<int, MutexLock> plain;
+    for (int i = 0; i < 10; i++)
+        plain.push_back(i);
+
+    plain.compact();
+    check(plain.uses_slab_storage() && list_matches(plain, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }), "compact switches a plain list to slabs");
+
+    std::cout << "---------------------------------\n";
+}
+
+// Checks that a SmallVector holds first, first + 1, ... length elements.
+template <typename V>
+bool holds_sequence(const V& vec, int first, size_t length)
+{
+    bool matches = vec.get_length() == length;
+
+    for (size_t i = 0; matches && i < length; i++)
+        matches = vec[static_cast<int>(i)] == std::to_string(first + static_cast<int>(i));
+
+    return matches;
+}
+
+void test_smallvector()
+{
+    std::cout << "\n---------------------------------\nSmall Vector\n";
+
+    using Small = SmallVector<std::string, 4, MutexLock>;
+
+    Small small;
+    Small spilled;
+
+    for (int i = 0; i < 3; i++)
+        small.push_back(std::to_string(i));
+
+    for (int i = 100; i < 110; i++)
+        spilled.push_back(std::to_string(i));
+
+    check(small.is_inline() && !spilled.is_inline(), "a vector spills to the heap past its inline capacity");
+
+    small.swap(spilled);
+    check(!small.is_inline() && holds_sequence(small, 100, 10), "swap hands the heap buffer to the inline side");
+    check(spilled.is_inline() && holds_sequence(spilled, 0, 3), "swap moves the inline elements to the heap side");
+
+    small.swap(spilled);
+    check(small.is_inline() && holds_sequence(small, 0, 3) && holds_sequence(spilled, 100, 10), "swapping back restores both sides");
+
+    Small from_inline(std::move(small));
+    Small from_heap(std::move(spilled));
+    check(from_inline.is_inline() && holds_sequence(from_inline, 0, 3), "moving an inline vector moves its elements");
+    check(!from_heap.is_inline() && holds_sequence(from_heap, 100, 10), "moving a spilled vector takes its buffer");
+
+    for (int i = 0; i < 6; i++)
+        spilled.push_back(std::to_string(i));
+
+    small.push_back("0");
+    check(holds_sequence(spilled, 0, 6) && holds_sequence(small, 0, 1) && small.is_inline(), "moved-from vectors can be reused");
+
+    from_inline = std::move(from_heap);
+    check(!from_inline.is_inline() && holds_sequence(from_inline, 100, 10), "move assignment takes a spilled vector's buffer");
+
+    Small copy = from_inline.clone();
+    copy.push_back("extra");
+    check(holds_sequence(from_inline, 100, 10) && copy.get_length() == 11 && copy[0] == "100", "clone is deep");
+
+    while (copy.try_pop()) { }
+    copy.push_back("again");
+    check(copy.get_length() == 1 && copy[0] == "again", "an emptied vector can be refilled");
+
+    std::cout << "---------------------------------\n";
+}
+
+// Pushes 1..4 into a full StaticVector and StaticStack, pops some back, and
+// returns a value that depends on every step; evaluated at compile time.
+constexpr int static_round_trip()
+{
+    StaticVector<int, 3> vec;
+    StaticStack<int, 3> stack;
+
+    for (int i = 1; i <= 4; i++)
+    {
+        if (!vec.try_push_back(i))
+            vec.pop();
+
+        if (!stack.try_push(i * 10))
+            stack.pop();
+    }
+
+    int result = static_cast<int>(vec.get_length()) * 1000 + vec.at(0) * 100 + stack.top();
+
+    return result + vec.pop();
+}
+
+static_assert(static_round_trip() == 2000 + 100 + 20 + 2, "StaticVector and StaticStack work in constant expressions");
+
+void test_static_containers()
+{
+    std::cout << "\n---------------------------------\nStatic Containers\n";
+
+    StaticVector<std::string, 2> vec;
+    check(vec.try_push_back("a") && vec.try_emplace_back(2, 'b'), "try_push_back accepts elements while there is room");
+    check(vec.is_full() && !vec.try_push_back("c") && !vec.try_emplace_back(1, 'c'), "try_push_back and try_emplace_back return false when full");
+    check(vec.get_length() == 2 && vec[1] == "bb", "a rejected push leaves the vector unchanged");
+
+    StaticVector<std::string, 2> vec_copy = vec;
+    vec_copy.pop();
+    vec_copy.push_back("changed");
+    check(vec.get_length() == 2 && vec[1] == "bb" && vec_copy[1] == "changed", "copying a StaticVector is deep");
+
+    StaticStack<std::string, 2> stack;
+    stack.push("x");
+    stack.emplace(3, 'y');
+    check(!stack.try_push("z") && !stack.try_emplace(1, 'z') && stack.top() == "yyy", "try_push and try_emplace return false when full");
+
+    StaticStack<std::string, 2> stack_copy = stack;
+    stack_copy.pop();
+    check(stack.top() == "yyy" && stack_copy.top() == "x", "copying a StaticStack is deep");
+
+    StaticVector<int, 4> trivial;
+    trivial.push_back(1);
+    check(trivial.try_pop() == 1 && !trivial.try_pop() && !trivial.try_at(0), "try_pop and try_at return nullopt once empty");
+
+#ifndef DS_NO_EXCEPTIONS
+    bool threw = false;
+    try { vec.push_back("overflow"); } catch (const std::length_error&) { threw = true; }
+    check(threw, "push_back throws when full");
+#endif
+
+    std::cout << "---------------------------------\n";
+}
+
+void test_try_accessors()
+{
+    std::cout << "\n---------------------------------\nTry Accessors\n";
+
+    Vector<int> vec;
+    check(!vec.try_pop() && !vec.try_at(0), "Vector try_pop and try_at return nullopt when empty");
+    vec.push_back(5);
+    check(vec.try_at(0) == 5 && !vec.try_at(-1) && !vec.try_at(1), "Vector try_at rejects out-of-range indices");
+    check(vec.try_pop() == 5 && !vec.try_pop(), "Vector try_pop returns the last element, then nullopt");
+
+    Stack<int> stack;
+    check(!stack.try_pop() && !stack.try_top() && !stack.try_at(0), "Stack try_pop, try_top and try_at return nullopt when empty");
+    stack.push(1);
+    stack.push(2);
+    check(stack.try_top() == 2 && stack.try_at(0) == 1 && !stack.try_at(-1) && !stack.try_at(2), "Stack try_top and try_at read valid positions only");
+    check(stack.try_pop() == 2 && stack.try_pop() == 1 && !stack.try_pop(), "Stack try_pop drains in LIFO order, then returns nullopt");
+
+    Queue<int> queue;
+    int out = -1;
+    check(!queue.try_pop() && !queue.try_pop(out) && out == -1, "Queue try_pop fails on an empty queue and leaves the output untouched");
+    check(!queue.try_front() && !queue.try_back() && !queue.try_at(0), "Queue try_front, try_back and try_at return nullopt when empty");
+    queue.push(1);
+    queue.push(2);
+    check(queue.try_front() == 1 && queue.try_back() == 2 && queue.try_at(1) == 2 && !queue.try_at(-1) && !queue.try_at(2), "Queue peeks read valid positions only");
+    check(queue.try_pop(out) && out == 1 && queue.try_pop() == 2 && !queue.try_pop(), "Queue try_pop drains in FIFO order, then fails");
+
+    DoublyLinkedList<int> list;
+    check(!list.try_pop_front() && !list.try_pop_back() && !list.try_at(0), "DoublyLinkedList try_* return nullopt when empty");
+    list.push_back(1);
+    list.push_back(2);
+    check(list.try_at(1) == 2 && !list.try_at(-1) && !list.try_at(2), "DoublyLinkedList try_at rejects out-of-range indices");
+    check(list.try_pop_front() == 1 && list.try_pop_back() == 2 && !list.try_pop_front() && !list.try_pop_back(), "DoublyLinkedList try_pop_front and try_pop_back drain both ends");
+
+    SmallVector<int, 2> small;
+    check(!small.try_pop() && !small.try_at(0), "SmallVector try_pop and try_at return nullopt when empty");
+    small.push_back(1);
+    small.push_back(2);
+    small.push_back(3);
+    check(small.try_at(2) == 3 && !small.try_at(-1) && !small.try_at(3), "SmallVector try_at rejects out-of-range indices once spilled");
+    check(small.try_pop() == 3 && small.try_pop() == 2 && small.try_pop() == 1 && !small.try_pop(), "SmallVector try_pop drains, then returns nullopt");
+
+    StaticStack<int, 2> static_stack;
+    check(!static_stack.try_pop() && !static_stack.try_top() && !static_stack.try_at(0), "StaticStack try_* return nullopt when empty");
+    static_stack.push(7);
+    check(static_stack.try_top() == 7 && static_stack.try_at(0) == 7 && !static_stack.try_at(1), "StaticStack try_top and try_at read valid positions only");
+
+    ConcurrentVector<int> concurrent;
+    check(!concurrent.try_at(0), "ConcurrentVector try_at returns nullopt when empty");
+    concurrent.push_back(4);
+    check(concurrent.try_at(0) == 4 && !concurrent.try_at(1), "ConcurrentVector try_at rejects indices past the end");
+
+    LockFreeQueue<int, true> peekable;
+    check(!peekable.try_front() && !peekable.try_pop(out), "LockFreeQueue try_front and try_pop fail when empty");
+    peekable.push(8);
+    check(peekable.try_front() == 8 && peekable.try_pop(out) && out == 8 && !peekable.try_front(), "LockFreeQueue try_front sees the head until it is popped");
+
+    TwoLockQueue<int> two_lock;
+    check(!two_lock.try_front() && !two_lock.try_pop(out), "TwoLockQueue try_front and try_pop fail when empty");
+    two_lock.push(9);
+    check(two_lock.try_front() == 9 && two_lock.try_pop(out) && out == 9 && !two_lock.try_front(), "TwoLockQueue try_front sees the head until it is popped");
+
+    std::cout << "---------------------------------\n";
+}
@@ -0,0 +1,221 @@
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "exceptions.h"
+
+// Bounded multi-producer, multi-consumer queue on a power-of-two ring of
+// slots. Each slot carries a sequence number that says whose turn it is:
+// equal to the position when it is free for the producer claiming that
+// position, and position + 1 once it holds an element for the matching
+// consumer. Producers claim positions with a CAS on tail and consumers with
+// a CAS on head, so no lock is taken and nothing is allocated after
+// construction.
+template <typename T>
+class MPMCQueue
+{
+private:
+	static_assert(std::is_nothrow_move_constructible<T>::value, "MPMCQueue elements must be nothrow move constructible");
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		T* element() { return reinterpret_cast<T*>(storage); }
+	};
+
+	size_t capacity;
+	Slot*  slots;
+
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+public:
+	explicit MPMCQueue(size_t capacity);
+	~MPMCQueue();
+
+	MPMCQueue(const MPMCQueue&) = delete;
+	MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+	// Return false instead of waiting when the queue is full or empty.
+	bool try_push(const T& element);
+	bool try_push(T&& element);
+	bool try_pop(T& element);
+
+	template <typename... Args>
+	bool try_emplace(Args&&... args);
+
+	// Exact only while no push or pop is in flight.
+	size_t get_size() const;
+	size_t get_length() const;
+	size_t get_capacity() const;
+	bool   is_empty() const;
+};
+
+template <typename T>
+MPMCQueue<T>::MPMCQueue(size_t capacity)
+	: capacity(1), head(0), tail(0)
+{
+	if (capacity == 0)
+		DS_THROW(std::invalid_argument("Capacity must be at least 1"));
+
+	while (this->capacity < capacity)
+		this->capacity *= 2;
+
+	slots = new Slot[this->capacity];
+
+	for (size_t i = 0; i < this->capacity; i++)
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+MPMCQueue<T>::~MPMCQueue()
+{
+	if constexpr (!std::is_trivially_destructible<T>::value)
+	{
+		size_t last = tail.load(std::memory_order_relaxed);
+
+		for (size_t position = head.load(std::memory_order_relaxed); position != last; position++)
+			slots[position & (capacity - 1)].element()->~T();
+	}
+
+	delete[] slots;
+}
+
+template <typename T>
+bool MPMCQueue<T>::try_push(const T& element)
+{
+	return try_emplace(element);
+}
+
+template <typename T>
+bool MPMCQueue<T>::try_push(T&& element)
+{
+	return try_emplace(std::move(element));
+}
+
+template <typename T>
+template <typename... Args>
+bool MPMCQueue<T>::try_emplace(Args&&... args)
+{
+	if constexpr (!std::is_nothrow_constructible<T, Args&&...>::value)
+	{
+		// A claimed position cannot be handed back, so anything that may
+		// throw happens before the claim.
+		return try_emplace(T(std::forward<Args>(args)...));
+	}
+
+	size_t position = tail.load(std::memory_order_relaxed);
+	Slot*  slot;
+
+	while (true)
+	{
+		slot = &slots[position & (capacity - 1)];
+
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		auto   turn = static_cast<std::ptrdiff_t>(sequence - position);
+
+		if (turn == 0)
+		{
+			if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (turn < 0)
+		{
+			// The consumer a lap behind has not emptied this slot yet.
+			return false;
+		}
+		else
+		{
+			position = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	::new (static_cast<void*>(slot->storage)) T(std::forward<Args>(args)...);
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <typename T>
+bool MPMCQueue<T>::try_pop(T& element)
+{
+	size_t position = head.load(std::memory_order_relaxed);
+	Slot*  slot;
+
+	while (true)
+	{
+		slot = &slots[position & (capacity - 1)];
+
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		auto   turn = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+		if (turn == 0)
+		{
+			if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (turn < 0)
+		{
+			return false;
+		}
+		else
+		{
+			position = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	DS_TRY
+	{
+		element = std::move(*slot->element());
+	}
+	DS_CATCH_ALL
+	{
+		slot->element()->~T();
+		slot->sequence.store(position + capacity, std::memory_order_release);
+		DS_RETHROW;
+	}
+
+	slot->element()->~T();
+
+	// Free for the producer one lap ahead.
+	slot->sequence.store(position + capacity, std::memory_order_release);
+
+	return true;
+}
+
+template <typename T>
+size_t MPMCQueue<T>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T>
+size_t MPMCQueue<T>::get_length() const
+{
+	size_t first = head.load(std::memory_order_relaxed);
+	size_t last = tail.load(std::memory_order_relaxed);
+
+	return last > first ? last - first : 0;
+}
+
+template <typename T>
+size_t MPMCQueue<T>::get_capacity() const
+{
+	return capacity;
+}
+
+template <typename T>
+bool MPMCQueue<T>::is_empty() const
+{
+	return get_length() == 0;
+}
+
+#endif
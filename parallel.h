@@ -0,0 +1,190 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+#include "exceptions.h"
+#include "threadpool.h"
+#include "vector.h"
+
+// Data-parallel algorithms over a Vector's contiguous buffer. Each call holds
+// the vector's lock for its whole duration and splits the buffer into chunks
+// that run on the given pool. They must not be called from inside a task of
+// the same pool.
+
+// Waits for every task and then rethrows the first exception, if any. The
+// tasks refer to the caller's frame and buffer, so none may still be queued
+// or running when an exception leaves the algorithm.
+inline void wait_all(std::vector<std::future<void>>& pending)
+{
+	for (auto& result : pending)
+		result.wait();
+
+	for (auto& result : pending)
+		result.get();
+}
+
+// Runs function(chunk, first, last) on every chunk of [0, length) and waits
+// for all of them.
+template <typename Function>
+void parallel_chunks(ThreadPool& pool, size_t length, size_t chunk_count, Function function)
+{
+	if (chunk_count > length)
+		chunk_count = length;
+
+	if (chunk_count <= 1)
+	{
+		function(size_t(0), size_t(0), length);
+		return;
+	}
+
+	std::vector<std::future<void>> pending;
+	pending.reserve(chunk_count);
+
+	DS_TRY
+	{
+		for (size_t chunk = 0; chunk < chunk_count; chunk++)
+		{
+			size_t first = length * chunk / chunk_count;
+			size_t last = length * (chunk + 1) / chunk_count;
+
+			pending.push_back(pool.submit([&function, chunk, first, last]() { function(chunk, first, last); }));
+		}
+	}
+	DS_CATCH_ALL
+	{
+		for (auto& result : pending)
+			result.wait();
+
+		DS_RETHROW;
+	}
+
+	wait_all(pending);
+}
+
+template <typename T, typename Lock, typename Allocator, typename Function>
+void parallel_for_each(Vector<T, Lock, Allocator>& vec, ThreadPool& pool, Function function)
+{
+	vec.access([&](T* data, size_t length)
+	{
+		parallel_chunks(pool, length, pool.get_size() * 4, [&](size_t, size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				function(data[i]);
+		});
+	});
+}
+
+// Replaces every element with function(element).
+template <typename T, typename Lock, typename Allocator, typename Function>
+void parallel_transform(Vector<T, Lock, Allocator>& vec, ThreadPool& pool, Function function)
+{
+	vec.access([&](T* data, size_t length)
+	{
+		parallel_chunks(pool, length, pool.get_size() * 4, [&](size_t, size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				data[i] = function(data[i]);
+		});
+	});
+}
+
+// op must be associative; chunks are folded independently and then combined
+// in order, starting from init. As with std::reduce the result has the type
+// of init, so a wider init (e.g. long long over a Vector<int>) accumulates
+// without overflowing, and op must accept any mix of Acc and T.
+template <typename T, typename Lock, typename Allocator, typename Acc, typename BinaryOp>
+Acc parallel_reduce(const Vector<T, Lock, Allocator>& vec, ThreadPool& pool, Acc init, BinaryOp op)
+{
+	return vec.access([&](const T* data, size_t length)
+	{
+		if (length == 0)
+			return init;
+
+		size_t chunk_count = std::min(pool.get_size() * 4, length);
+		std::vector<Acc> partials(chunk_count, init);
+
+		parallel_chunks(pool, length, chunk_count, [&](size_t chunk, size_t first, size_t last)
+		{
+			Acc partial = data[first];
+			for (size_t i = first + 1; i < last; i++)
+				partial = op(partial, data[i]);
+
+			partials[chunk] = partial;
+		});
+
+		Acc result = init;
+		for (const Acc& partial : partials)
+			result = op(result, partial);
+
+		return result;
+	});
+}
+
+// Sorts one chunk per worker, then merges neighbouring runs pairwise in
+// parallel until a single run remains.
+template <typename T, typename Lock, typename Allocator, typename Compare = std::less<T>>
+void parallel_sort(Vector<T, Lock, Allocator>& vec, ThreadPool& pool, Compare compare = Compare())
+{
+	vec.access([&](T* data, size_t length)
+	{
+		size_t run_count = std::min(pool.get_size(), length);
+		if (run_count <= 1)
+		{
+			std::sort(data, data + length, compare);
+			return;
+		}
+
+		std::vector<size_t> bounds(run_count + 1);
+		for (size_t run = 0; run <= run_count; run++)
+			bounds[run] = length * run / run_count;
+
+		parallel_chunks(pool, length, run_count, [&](size_t, size_t first, size_t last)
+		{
+			std::sort(data + first, data + last, compare);
+		});
+
+		while (bounds.size() > 2)
+		{
+			std::vector<std::future<void>> pending;
+			std::vector<size_t> merged_bounds;
+
+			DS_TRY
+			{
+				for (size_t run = 0; run + 2 < bounds.size(); run += 2)
+				{
+					size_t first = bounds[run];
+					size_t middle = bounds[run + 1];
+					size_t last = bounds[run + 2];
+
+					pending.push_back(pool.submit([=, &compare]()
+					{
+						std::inplace_merge(data + first, data + middle, data + last, compare);
+					}));
+
+					merged_bounds.push_back(first);
+				}
+
+				if (bounds.size() % 2 == 0)
+					merged_bounds.push_back(bounds[bounds.size() - 2]);
+
+				merged_bounds.push_back(bounds.back());
+			}
+			DS_CATCH_ALL
+			{
+				for (auto& result : pending)
+					result.wait();
+
+				DS_RETHROW;
+			}
+
+			wait_all(pending);
+
+			bounds.swap(merged_bounds);
+		}
+	});
+}
+
+#endif
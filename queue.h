@@ -1,273 +1,959 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-#include <iostream>
-#include <functional>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
-template <typename T>
+#include "exceptions.h"
+#include "lockpolicy.h"
+
+template <typename T, typename Lock = RuntimeLock, typename Allocator = std::allocator<T>>
 class Queue
 {
 private:
-	size_t             size;
-	mutable std::mutex mutex;
-	bool               is_thread_safe;
+	size_t       size;
+	mutable Lock mutex;
 
 	struct Node
 	{
 		T data;
 		Node* next;
 
-		Node(const T& data) : data(data), next(nullptr) { }
+		template <typename... Args>
+		Node(Args&&... args) : data(std::forward<Args>(args)...), next(nullptr) { }
 	};
 
-	Node* front_node;
-	Node* back_node;
+	using NodeAllocator       = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+	using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
 
-public:
-	std::function<T()>            pop;
-	std::function<T()>            front;
-	std::function<T()>            back;
-	std::function<void(const T&)> push;
-	std::function<T(int)>         at;
-	std::function<size_t()>       get_size;
-	std::function<size_t()>       get_length;
+	// A stateless allocator can be called outside the lock; a stateful one
+	// (e.g. a pmr arena) is only touched while the lock is held.
+	static constexpr bool allocates_outside_lock = NodeAllocatorTraits::is_always_equal::value;
+
+	// Storage of a popped node kept for reuse; the node itself has already
+	// been destroyed.
+	struct FreeNode
+	{
+		FreeNode* next;
+	};
+
+	// Per-thread stash of free node storage, shared by every queue of this
+	// type. Only stateless allocators qualify, since any instance can then
+	// free any other's nodes.
+	static constexpr bool   can_cache_per_thread = allocates_outside_lock && std::is_default_constructible<NodeAllocator>::value;
+	static constexpr size_t thread_cache_size = 64;
+
+	struct ThreadCache
+	{
+		Node*  nodes[thread_cache_size];
+		size_t count = 0;
+
+		~ThreadCache()
+		{
+			NodeAllocator allocator;
+
+			while (count)
+				NodeAllocatorTraits::deallocate(allocator, nodes[--count], 1);
+		}
+	};
+
+	NodeAllocator       node_allocator;
+	Node*               front_node;
+	Node*               back_node;
+	FreeNode*           free_nodes;
+	size_t              free_count;
+	std::atomic<size_t> pool_limit;
+	std::atomic<bool>   thread_cache;
+
+	// wait_pop spins this many rounds before sleeping on not_empty, and
+	// producers only notify while waiting_consumers says someone is asleep.
+	static constexpr int wait_spins = 64;
+
+	std::condition_variable_any not_empty;
+	size_t                      waiting_consumers;
+	bool                        closed;
 
 public:
-	Queue(bool is_thread_safe);
+	explicit Queue(const Allocator& allocator = Allocator());
+
+	template <typename B, enable_if_bool<B> = 0>
+	explicit Queue(B is_thread_safe, const Allocator& allocator = Allocator());
+	Queue(Queue&& other);
 	~Queue();
 
+	Queue& operator=(Queue&& other);
+	Queue& operator=(const Queue&) = delete;
+
+	void  swap(Queue& other);
+	Queue clone() const;
+
+	T    pop();
+	bool try_pop(T& element);
+	T    front() const;
+	T    back() const;
+	void push(const T& element);
+	void push(T&& element);
+	T    at(int index) const;
+
+	// Return std::nullopt where pop, front, back and at would throw.
+	std::optional<T> try_pop();
+	std::optional<T> try_front() const;
+	std::optional<T> try_back() const;
+	std::optional<T> try_at(int index) const;
+
+	size_t get_size() const;
+	size_t get_length() const;
+
+	Allocator get_allocator() const;
+
+	// Node recycling. Popped nodes are kept on a per-queue freelist of at
+	// most get_node_pool_limit() nodes (0, the default, turns it off) and
+	// reused by later pushes, so a warmed-up queue stops calling the
+	// allocator. reserve_nodes pre-allocates the freelist, raising the limit
+	// if needed. With the thread cache on, each thread also keeps a few free
+	// nodes it can use without taking the lock.
+	void   reserve_nodes(size_t count);
+	void   set_node_pool_limit(size_t limit);
+	size_t get_node_pool_limit() const;
+	size_t get_pooled_nodes() const;
+	void   set_thread_cache(bool enabled);
+
+	template <typename... Args>
+	void emplace(Args&&... args);
+
+	template <typename InputIt>
+	void push_bulk(InputIt first, InputIt last);
+
+	template <typename OutputIt>
+	size_t pop_bulk(OutputIt out, size_t max_count);
+
+	// Blocking pops. They wait for an element, spinning briefly before
+	// sleeping, and return false once the queue is closed and drained (or,
+	// for wait_pop_for, when the timeout expires). Waiting needs a real lock
+	// and another thread to push or close.
+	bool wait_pop(T& element);
+
+	template <typename Rep, typename Period>
+	bool wait_pop_for(T& element, const std::chrono::duration<Rep, Period>& timeout);
+
+	// Wakes every waiting consumer. Pushes are still accepted, and what is
+	// left can still be popped; only waiting on an empty queue stops.
+	void close();
+	bool is_closed() const;
+
 	const T& operator[](int index) const;
 
 private:
-	void initialize_functions();
-	bool is_empty();
+	Queue(const Queue& other);
+
+	bool is_empty() const;
+	void destroy_nodes();
+	void steal(Queue& other);
+	void link_back(Node* node);
+	Node* unlink_front();
+	bool  wait_for_element(std::unique_lock<Lock>& lock, const std::chrono::steady_clock::time_point* deadline);
+
+	template <typename... Args>
+	Node* create_node(Args&&... args);
+	template <typename... Args>
+	Node* construct_node(Node* storage, Args&&... args);
+	void  destroy_node(Node* node);
+	void  destroy_chain(Node* node);
+
+	Node* take_free_node();
+	bool  keep_free_node(Node* storage);
+	void  release_free_nodes(size_t keep);
+	FreeNode* keep_free_chain(FreeNode* chain);
+	void      deallocate_free_chain(FreeNode* chain);
+	Node* take_cached_node();
+	bool  cache_node(Node* storage);
+	void  recycle_node(Node* node, std::unique_lock<Lock>& lock);
+
+	static ThreadCache& get_thread_cache();
+};
 
-	T thread_safe_pop();
-	T no_thread_safe_pop();
+template <typename T, typename Lock, typename Allocator>
+Queue<T, Lock, Allocator>::Queue(const Allocator& allocator)
+	: size(0), node_allocator(allocator), front_node(nullptr), back_node(nullptr),
+	  free_nodes(nullptr), free_count(0), pool_limit(0), thread_cache(false), waiting_consumers(0), closed(false)
+{
+}
 
-	T thread_safe_front();
-	T no_thread_safe_front();
+template <typename T, typename Lock, typename Allocator>
+template <typename B, enable_if_bool<B>>
+Queue<T, Lock, Allocator>::Queue(B is_thread_safe, const Allocator& allocator)
+	: size(0), mutex(is_thread_safe), node_allocator(allocator), front_node(nullptr), back_node(nullptr),
+	  free_nodes(nullptr), free_count(0), pool_limit(0), thread_cache(false), waiting_consumers(0), closed(false)
+{
+}
 
-	T thread_safe_back();
-	T no_thread_safe_back();
+template <typename T, typename Lock, typename Allocator>
+Queue<T, Lock, Allocator>::Queue(const Queue& other)
+	: size(0), mutex(other.mutex),
+	  node_allocator(NodeAllocatorTraits::select_on_container_copy_construction(other.node_allocator)),
+	  front_node(nullptr), back_node(nullptr), free_nodes(nullptr), free_count(0),
+	  pool_limit(other.pool_limit.load(std::memory_order_relaxed)),
+	  thread_cache(other.thread_cache.load(std::memory_order_relaxed)), waiting_consumers(0), closed(false)
+{
+	std::shared_lock<Lock> lock(other.mutex);
 
-	void thread_safe_push(const T& element);
-	void no_thread_safe_push(const T& element);
+	DS_TRY
+	{
+		for (Node* current = other.front_node; current; current = current->next)
+			link_back(create_node(current->data));
+	}
+	DS_CATCH_ALL
+	{
+		destroy_nodes();
+		DS_RETHROW;
+	}
+}
 
-	T thread_safe_at(int index);
-	T no_thread_safe_at(int index);
+template <typename T, typename Lock, typename Allocator>
+Queue<T, Lock, Allocator>::Queue(Queue&& other)
+	: mutex(other.mutex), node_allocator(other.node_allocator), free_nodes(nullptr), free_count(0),
+	  pool_limit(other.pool_limit.load(std::memory_order_relaxed)),
+	  thread_cache(other.thread_cache.load(std::memory_order_relaxed)), waiting_consumers(0), closed(false)
+{
+	std::lock_guard<Lock> lock(other.mutex);
 
-	size_t thread_safe_get_size();
-	size_t no_thread_safe_get_size();
+	steal(other);
+}
 
-	size_t thread_safe_get_length();
-	size_t no_thread_safe_get_length();
-};
+template <typename T, typename Lock, typename Allocator>
+Queue<T, Lock, Allocator>::~Queue()
+{
+	destroy_nodes();
+	release_free_nodes(0);
+}
 
-template <typename T>
-Queue<T>::Queue(bool is_thread_safe)
-	: size(0), is_thread_safe(is_thread_safe)
+template <typename T, typename Lock, typename Allocator>
+Queue<T, Lock, Allocator>& Queue<T, Lock, Allocator>::operator=(Queue&& other)
 {
-	initialize_functions();
+	if (this == &other)
+		return *this;
+
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	destroy_nodes();
+
+	if (NodeAllocatorTraits::propagate_on_container_move_assignment::value || node_allocator == other.node_allocator)
+	{
+		if constexpr (NodeAllocatorTraits::propagate_on_container_move_assignment::value)
+		{
+			release_free_nodes(0);
+			node_allocator = std::move(other.node_allocator);
+		}
+
+		steal(other);
+	}
+	else
+	{
+		// Our allocator cannot free other's nodes, so the payloads move into
+		// nodes we allocate ourselves.
+		for (Node* current = other.front_node; current; current = current->next)
+			link_back(create_node(std::move(current->data)));
+
+		other.destroy_nodes();
+	}
+
+	if (waiting_consumers)
+		not_empty.notify_all();
+
+	return *this;
 }
 
-template <typename T>
-Queue<T>::~Queue()
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::swap(Queue& other)
 {
-	while (!is_empty())
+	if (this == &other)
+		return;
+
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	if constexpr (NodeAllocatorTraits::propagate_on_container_swap::value)
 	{
-		pop();
+		std::swap(node_allocator, other.node_allocator);
+		std::swap(free_nodes, other.free_nodes);
+		std::swap(free_count, other.free_count);
 	}
+	else if (!(node_allocator == other.node_allocator))
+		DS_THROW(std::invalid_argument("Cannot swap containers with unequal allocators"));
+
+	std::swap(size, other.size);
+	std::swap(front_node, other.front_node);
+	std::swap(back_node, other.back_node);
+
+	if (waiting_consumers)
+		not_empty.notify_all();
+	if (other.waiting_consumers)
+		other.not_empty.notify_all();
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::steal(Queue& other)
+{
+	size       = other.size;
+	front_node = other.front_node;
+	back_node  = other.back_node;
+
+	other.size       = 0;
+	other.front_node = nullptr;
+	other.back_node  = nullptr;
+}
+
+template <typename T, typename Lock, typename Allocator>
+Queue<T, Lock, Allocator> Queue<T, Lock, Allocator>::clone() const
+{
+	return Queue(*this);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::destroy_nodes()
+{
+	destroy_chain(front_node);
+
+	front_node = nullptr;
+	back_node = nullptr;
+	size = 0;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::link_back(Node* node)
+{
+	if (is_empty())
+		front_node = back_node = node;
+	else
+		back_node = back_node->next = node;
+
+	size++;
 }
 
-template <typename T>
-const T& Queue<T>::operator[](int index) const
+template <typename T, typename Lock, typename Allocator>
+typename Queue<T, Lock, Allocator>::Node* Queue<T, Lock, Allocator>::unlink_front()
 {
-	if (is_thread_safe)
+	Node* node = front_node;
+	front_node = front_node->next;
+
+	size--;
+	if (is_empty())
 	{
-		std::lock_guard<std::mutex> lock(mutex);
+		front_node = nullptr;
+		back_node = nullptr;
+	}
 
-		Node* current = front_node;
-		for (size_t i = 0; i < index; i++)
-			current = current->next;
+	return node;
+}
 
-		return current->data;
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+typename Queue<T, Lock, Allocator>::Node* Queue<T, Lock, Allocator>::create_node(Args&&... args)
+{
+	return construct_node(NodeAllocatorTraits::allocate(node_allocator, 1), std::forward<Args>(args)...);
+}
+
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+typename Queue<T, Lock, Allocator>::Node* Queue<T, Lock, Allocator>::construct_node(Node* storage, Args&&... args)
+{
+	DS_TRY
+	{
+		NodeAllocatorTraits::construct(node_allocator, storage, std::forward<Args>(args)...);
+	}
+	DS_CATCH_ALL
+	{
+		NodeAllocatorTraits::deallocate(node_allocator, storage, 1);
+		DS_RETHROW;
 	}
 
-	Node* current = front_node;
-	for (size_t i = 0; i < index; i++)
-		current = current->next;
+	return storage;
+}
 
-	return current->data;
-	
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::destroy_node(Node* node)
+{
+	NodeAllocatorTraits::destroy(node_allocator, node);
+	NodeAllocatorTraits::deallocate(node_allocator, node, 1);
 }
 
-template <typename T>
-void Queue<T>::initialize_functions()
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::destroy_chain(Node* node)
 {
-	if (is_thread_safe)
+	while (node)
 	{
-		pop = [this]() { return this->thread_safe_pop(); };
-		front = [this]() { return this->thread_safe_front(); };
-		back = [this]() { return this->thread_safe_back(); };
-		push = [this](const T& element) { this->thread_safe_push(element); };
-		at = [this](int index) { return this->thread_safe_at(index); };
-		get_size = [this]() { return this->thread_safe_get_size(); };
-		get_length = [this]() { return this->thread_safe_get_length(); };
+		Node* temp = node;
+		node = node->next;
+		destroy_node(temp);
 	}
-	else
+}
+
+template <typename T, typename Lock, typename Allocator>
+Allocator Queue<T, Lock, Allocator>::get_allocator() const
+{
+	return Allocator(node_allocator);
+}
+
+template <typename T, typename Lock, typename Allocator>
+typename Queue<T, Lock, Allocator>::Node* Queue<T, Lock, Allocator>::take_free_node()
+{
+	if (!free_nodes)
+		return nullptr;
+
+	FreeNode* storage = free_nodes;
+	free_nodes = storage->next;
+	free_count--;
+
+	return reinterpret_cast<Node*>(storage);
+}
+
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::keep_free_node(Node* storage)
+{
+	if (free_count >= pool_limit.load(std::memory_order_relaxed))
+		return false;
+
+	free_nodes = ::new (static_cast<void*>(storage)) FreeNode{ free_nodes };
+	free_count++;
+
+	return true;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::release_free_nodes(size_t keep)
+{
+	while (free_count > keep)
+		NodeAllocatorTraits::deallocate(node_allocator, take_free_node(), 1);
+}
+
+// Moves free storage onto the freelist until it is full and returns the rest.
+template <typename T, typename Lock, typename Allocator>
+typename Queue<T, Lock, Allocator>::FreeNode* Queue<T, Lock, Allocator>::keep_free_chain(FreeNode* chain)
+{
+	while (chain)
 	{
-		pop = [this]() { return this->no_thread_safe_pop(); };
-		front = [this]() { return this->no_thread_safe_front(); };
-		back = [this]() { return this->no_thread_safe_back(); };
-		push = [this](const T& element) { this->no_thread_safe_push(element); };
-		at = [this](int index) { return this->no_thread_safe_at(index); };
-		get_size = [this]() { return this->no_thread_safe_get_size(); };
-		get_length = [this]() { return this->no_thread_safe_get_length(); };
+		FreeNode* next = chain->next;
+		if (!keep_free_node(reinterpret_cast<Node*>(chain)))
+			break;
+
+		chain = next;
 	}
+
+	return chain;
 }
 
-template <typename T>
-bool Queue<T>::is_empty()
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::deallocate_free_chain(FreeNode* chain)
 {
-	return (size == 0);
+	while (chain)
+	{
+		FreeNode* next = chain->next;
+		NodeAllocatorTraits::deallocate(node_allocator, reinterpret_cast<Node*>(chain), 1);
+		chain = next;
+	}
 }
 
-template <typename T>
-T Queue<T>::thread_safe_pop()
+template <typename T, typename Lock, typename Allocator>
+typename Queue<T, Lock, Allocator>::ThreadCache& Queue<T, Lock, Allocator>::get_thread_cache()
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	thread_local ThreadCache cache;
 
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	return cache;
+}
 
-	Node* temp = front_node;
-	front_node = front_node->next;
+template <typename T, typename Lock, typename Allocator>
+typename Queue<T, Lock, Allocator>::Node* Queue<T, Lock, Allocator>::take_cached_node()
+{
+	if constexpr (can_cache_per_thread)
+	{
+		if (thread_cache.load(std::memory_order_relaxed))
+		{
+			ThreadCache& cache = get_thread_cache();
 
-	T popped_element = temp->data;
+			if (cache.count)
+				return cache.nodes[--cache.count];
+		}
+	}
 
-	delete temp;
+	return nullptr;
+}
 
-	size--;
-	if (is_empty())
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::cache_node(Node* storage)
+{
+	if constexpr (can_cache_per_thread)
 	{
-		front_node = nullptr;
-		back_node = nullptr;
+		if (thread_cache.load(std::memory_order_relaxed))
+		{
+			ThreadCache& cache = get_thread_cache();
+
+			if (cache.count < thread_cache_size)
+			{
+				cache.nodes[cache.count++] = storage;
+				return true;
+			}
+		}
 	}
 
+	return false;
+}
+
+// Destroys a node unlinked under lock and puts its storage on the freelist,
+// else in the thread cache, else back to the allocator. May release the lock.
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::recycle_node(Node* node, std::unique_lock<Lock>& lock)
+{
+	NodeAllocatorTraits::destroy(node_allocator, node);
+
+	if (keep_free_node(node))
+		return;
+
+	if (allocates_outside_lock)
+		lock.unlock();
+
+	if (!cache_node(node))
+		NodeAllocatorTraits::deallocate(node_allocator, node, 1);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::reserve_nodes(size_t count)
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	if (pool_limit.load(std::memory_order_relaxed) < count)
+		pool_limit.store(count, std::memory_order_relaxed);
+
+	while (free_count < count)
+		keep_free_node(NodeAllocatorTraits::allocate(node_allocator, 1));
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::set_node_pool_limit(size_t limit)
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	pool_limit.store(limit, std::memory_order_relaxed);
+	release_free_nodes(limit);
+}
+
+template <typename T, typename Lock, typename Allocator>
+size_t Queue<T, Lock, Allocator>::get_node_pool_limit() const
+{
+	return pool_limit.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename Lock, typename Allocator>
+size_t Queue<T, Lock, Allocator>::get_pooled_nodes() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return free_count;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::set_thread_cache(bool enabled)
+{
+	static_assert(can_cache_per_thread, "The thread cache needs a stateless, default-constructible allocator");
+
+	thread_cache.store(enabled, std::memory_order_relaxed);
+}
+
+template <typename T, typename Lock, typename Allocator>
+const T& Queue<T, Lock, Allocator>::operator[](int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	if (index < 0 || index >= size)
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	Node* current = front_node;
+	for (size_t i = 0; i < index; i++)
+		current = current->next;
+
+	return current->data;
+}
+
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::is_empty() const
+{
+	return (size == 0);
+}
+
+template <typename T, typename Lock, typename Allocator>
+T Queue<T, Lock, Allocator>::pop()
+{
+	std::unique_lock<Lock> lock(mutex);
+
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	T popped_element = std::move(front_node->data);
+	recycle_node(unlink_front(), lock);
+
 	return popped_element;
 }
 
-template <typename T>
-T Queue<T>::no_thread_safe_pop()
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::try_pop(T& element)
 {
+	std::unique_lock<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		return false;
 
-	Node* temp = front_node;
-	front_node = front_node->next;
+	element = std::move(front_node->data);
+	recycle_node(unlink_front(), lock);
 
-	T popped_element = temp->data;
+	return true;
+}
 
-	delete temp;
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Queue<T, Lock, Allocator>::try_pop()
+{
+	std::unique_lock<Lock> lock(mutex);
 
-	size--;
 	if (is_empty())
+		return std::nullopt;
+
+	std::optional<T> popped_element(std::move(front_node->data));
+	recycle_node(unlink_front(), lock);
+
+	return popped_element;
+}
+
+// Returns with the lock held once there is an element to pop, or false if
+// the queue was closed while empty or the deadline passed. A few short
+// rounds of releasing the lock and yielding come first, since a producer is
+// often about to push, and sleeping on the condition variable costs two
+// system calls.
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::wait_for_element(std::unique_lock<Lock>& lock, const std::chrono::steady_clock::time_point* deadline)
+{
+	for (int spin = 0; spin < wait_spins && is_empty() && !closed; spin++)
 	{
-		front_node = nullptr;
-		back_node = nullptr;
+		lock.unlock();
+		std::this_thread::yield();
+		lock.lock();
 	}
 
-	return popped_element;
+	while (is_empty() && !closed)
+	{
+		waiting_consumers++;
+
+		bool timed_out = false;
+		if (deadline)
+			timed_out = not_empty.wait_until(lock, *deadline) == std::cv_status::timeout;
+		else
+			not_empty.wait(lock);
+
+		waiting_consumers--;
+
+		if (timed_out)
+			break;
+	}
+
+	return !is_empty();
 }
 
-template <typename T>
-T Queue<T>::thread_safe_front()
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::wait_pop(T& element)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<Lock> lock(mutex);
 
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	if (!wait_for_element(lock, nullptr))
+		return false;
 
-	return front_node->data;
+	element = std::move(front_node->data);
+	recycle_node(unlink_front(), lock);
+
+	return true;
+}
+
+template <typename T, typename Lock, typename Allocator>
+template <typename Rep, typename Period>
+bool Queue<T, Lock, Allocator>::wait_pop_for(T& element, const std::chrono::duration<Rep, Period>& timeout)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+
+	std::unique_lock<Lock> lock(mutex);
+
+	if (!wait_for_element(lock, &deadline))
+		return false;
+
+	element = std::move(front_node->data);
+	recycle_node(unlink_front(), lock);
+
+	return true;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::close()
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	closed = true;
+	not_empty.notify_all();
 }
 
-template <typename T>
-T Queue<T>::no_thread_safe_front()
+template <typename T, typename Lock, typename Allocator>
+bool Queue<T, Lock, Allocator>::is_closed() const
 {
+	std::shared_lock<Lock> lock(mutex);
+
+	return closed;
+}
+
+template <typename T, typename Lock, typename Allocator>
+T Queue<T, Lock, Allocator>::front() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
 	return front_node->data;
 }
 
-template <typename T>
-T Queue<T>::thread_safe_back()
+template <typename T, typename Lock, typename Allocator>
+T Queue<T, Lock, Allocator>::back() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
 	return back_node->data;
 }
 
-template <typename T>
-T Queue<T>::no_thread_safe_back()
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Queue<T, Lock, Allocator>::try_front() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	if (is_empty())
+		return std::nullopt;
+
+	return front_node->data;
+}
+
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Queue<T, Lock, Allocator>::try_back() const
 {
+	std::shared_lock<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		return std::nullopt;
 
 	return back_node->data;
 }
 
-template <typename T>
-void Queue<T>::thread_safe_push(const T& element)
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::push(const T& element)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	emplace(element);
+}
 
-	Node* node = new Node(element);
+template <typename T, typename Lock, typename Allocator>
+void Queue<T, Lock, Allocator>::push(T&& element)
+{
+	emplace(std::move(element));
+}
 
-	if (is_empty())
+// Node storage comes from the thread cache, then the freelist, then the
+// allocator. Only a node taken from the freelist is constructed under the
+// lock when the allocator would otherwise allow it outside.
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+void Queue<T, Lock, Allocator>::emplace(Args&&... args)
+{
+	std::unique_lock<Lock> lock(mutex, std::defer_lock);
+
+	Node* storage = take_cached_node();
+
+	if (!storage && (!allocates_outside_lock || pool_limit.load(std::memory_order_relaxed)))
 	{
-		front_node = back_node = node;
+		lock.lock();
+		storage = take_free_node();
+
+		if (!storage && allocates_outside_lock)
+			lock.unlock();
 	}
-	else
+
+	if (!storage)
+		storage = NodeAllocatorTraits::allocate(node_allocator, 1);
+
+	Node* node = construct_node(storage, std::forward<Args>(args)...);
+
+	if (!lock.owns_lock())
+		lock.lock();
+
+	link_back(node);
+
+	if (waiting_consumers)
+		not_empty.notify_one();
+}
+
+// Builds the node chain outside the lock, then splices it in with one
+// acquisition. When node recycling is on, the whole freelist is borrowed up
+// front and whatever is left of it goes back with the splice.
+template <typename T, typename Lock, typename Allocator>
+template <typename InputIt>
+void Queue<T, Lock, Allocator>::push_bulk(InputIt first, InputIt last)
+{
+	std::unique_lock<Lock> lock(mutex, std::defer_lock);
+
+	FreeNode* borrowed = nullptr;
+
+	if (!allocates_outside_lock || pool_limit.load(std::memory_order_relaxed))
 	{
-		back_node->next = node;
-		back_node = node;
+		lock.lock();
+
+		borrowed = free_nodes;
+		free_nodes = nullptr;
+		free_count = 0;
+
+		if (allocates_outside_lock)
+			lock.unlock();
 	}
 
-	size++;
+	Node*  chain_front = nullptr;
+	Node*  chain_back = nullptr;
+	size_t count = 0;
+
+	DS_TRY
+	{
+		for (; first != last; ++first, ++count)
+		{
+			Node* storage = take_cached_node();
+
+			if (!storage && borrowed)
+			{
+				storage = reinterpret_cast<Node*>(borrowed);
+				borrowed = borrowed->next;
+			}
+
+			if (!storage)
+				storage = NodeAllocatorTraits::allocate(node_allocator, 1);
+
+			Node* node = construct_node(storage, *first);
+
+			if (chain_back)
+				chain_back = chain_back->next = node;
+			else
+				chain_front = chain_back = node;
+		}
+	}
+	DS_CATCH_ALL
+	{
+		destroy_chain(chain_front);
+
+		if (!lock.owns_lock())
+			lock.lock();
+
+		deallocate_free_chain(keep_free_chain(borrowed));
+		DS_RETHROW;
+	}
+
+	if (!lock.owns_lock())
+		lock.lock();
+
+	borrowed = keep_free_chain(borrowed);
+
+	if (count)
+	{
+		if (is_empty())
+			front_node = chain_front;
+		else
+			back_node->next = chain_front;
+
+		back_node = chain_back;
+		size += count;
+
+		if (waiting_consumers)
+			not_empty.notify_all();
+	}
+
+	if (allocates_outside_lock)
+		lock.unlock();
+
+	deallocate_free_chain(borrowed);
 }
 
-template <typename T>
-void Queue<T>::no_thread_safe_push(const T& element)
+// Detaches up to max_count nodes under one lock, then moves the payloads to
+// out and recycles the nodes, after releasing the lock when the allocator
+// allows it.
+template <typename T, typename Lock, typename Allocator>
+template <typename OutputIt>
+size_t Queue<T, Lock, Allocator>::pop_bulk(OutputIt out, size_t max_count)
 {
-	Node* node = new Node(element);
+	std::unique_lock<Lock> lock(mutex);
+
+	size_t count = max_count < size ? max_count : size;
+	if (!count)
+		return 0;
+
+	Node* chain_front = front_node;
 
+	Node* chain_back = front_node;
+	for (size_t i = 1; i < count; i++)
+		chain_back = chain_back->next;
+
+	front_node = chain_back->next;
+	chain_back->next = nullptr;
+
+	size -= count;
 	if (is_empty())
+		back_node = nullptr;
+
+	if (allocates_outside_lock)
+		lock.unlock();
+
+	FreeNode* spare = nullptr;
+
+	for (Node* node = chain_front; node; )
 	{
-		front_node = back_node = node;
+		*out++ = std::move(node->data);
+
+		Node* next = node->next;
+		NodeAllocatorTraits::destroy(node_allocator, node);
+
+		if (!(lock.owns_lock() && keep_free_node(node)) && !cache_node(node))
+			spare = ::new (static_cast<void*>(node)) FreeNode{ spare };
+
+		node = next;
 	}
-	else
+
+	// Whatever the thread cache had no room for goes to the freelist in one
+	// more acquisition.
+	if (spare && !lock.owns_lock() && pool_limit.load(std::memory_order_relaxed))
 	{
-		back_node->next = node;
-		back_node = node;
+		lock.lock();
+		spare = keep_free_chain(spare);
+		lock.unlock();
 	}
 
-	size++;
+	deallocate_free_chain(spare);
+
+	return count;
 }
 
-template <typename T>
-T Queue<T>::thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+T Queue<T, Lock, Allocator>::at(int index) const
 {
-	std::lock_guard<std::mutex> lock(mutex);
-	
+	std::shared_lock<Lock> lock(mutex);
+
 	if (index < 0 || index >= size)
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
 	if (index == 0)
 		return front_node->data;
@@ -282,17 +968,13 @@ T Queue<T>::thread_safe_at(int index)
 	return current->data;
 }
 
-template <typename T>
-T Queue<T>::no_thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Queue<T, Lock, Allocator>::try_at(int index) const
 {
-	if (index < 0 || index >= size)
-		throw std::out_of_range("Index out of range");
-
-	if (index == 0)
-		return front_node->data;
+	std::shared_lock<Lock> lock(mutex);
 
-	else if (index == size - 1)
-		return back_node->data;
+	if (index < 0 || index >= size)
+		return std::nullopt;
 
 	Node* current = front_node;
 	for (size_t i = 0; i < index; i++)
@@ -301,32 +983,26 @@ T Queue<T>::no_thread_safe_at(int index)
 	return current->data;
 }
 
-template <typename T>
-size_t Queue<T>::thread_safe_get_size()
+template <typename T, typename Lock, typename Allocator>
+size_t Queue<T, Lock, Allocator>::get_size() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
 	return size * sizeof(T);
 }
 
-template <typename T>
-size_t Queue<T>::no_thread_safe_get_size()
+template <typename T, typename Lock, typename Allocator>
+size_t Queue<T, Lock, Allocator>::get_length() const
 {
-	return size * sizeof(T);
-}
-
-template <typename T>
-size_t Queue<T>::thread_safe_get_length()
-{
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
 	return size;
 }
 
-template <typename T>
-size_t Queue<T>::no_thread_safe_get_length()
+namespace pmr
 {
-	return size;
+	template <typename T, typename Lock = RuntimeLock>
+	using Queue = ::Queue<T, Lock, std::pmr::polymorphic_allocator<T>>;
 }
 
-#endif
\ No newline at end of file
+#endif
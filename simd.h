@@ -0,0 +1,263 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Bulk kernels over contiguous arithmetic buffers. int32_t, float and double
+// get hand-written AVX2 and SSE4.1 paths chosen at runtime from the CPU's
+// feature flags; every other arithmetic type, and every non-x86 or non-GCC
+// build, uses the scalar fallback.
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define DS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace simd
+{
+	enum class Level { Scalar, SSE41, AVX2 };
+
+	inline Level detect_level()
+	{
+#ifdef DS_SIMD_X86
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2"))
+			return Level::AVX2;
+
+		if (__builtin_cpu_supports("sse4.1"))
+			return Level::SSE41;
+#endif
+		return Level::Scalar;
+	}
+
+	inline Level level()
+	{
+		static const Level detected = detect_level();
+
+		return detected;
+	}
+
+	namespace scalar
+	{
+		template <typename T>
+		T sum(const T* data, size_t length)
+		{
+			T total = T();
+			for (size_t i = 0; i < length; i++)
+				total += data[i];
+
+			return total;
+		}
+
+		template <typename T>
+		T min(const T* data, size_t length)
+		{
+			return *std::min_element(data, data + length);
+		}
+
+		template <typename T>
+		T max(const T* data, size_t length)
+		{
+			return *std::max_element(data, data + length);
+		}
+
+		template <typename T>
+		size_t count(const T* data, size_t length, T value)
+		{
+			return std::count(data, data + length, value);
+		}
+
+		template <typename T>
+		size_t find(const T* data, size_t length, T value)
+		{
+			return std::find(data, data + length, value) - data;
+		}
+
+		template <typename T>
+		void fill(T* data, size_t length, T value)
+		{
+			std::fill(data, data + length, value);
+		}
+	}
+
+#ifdef DS_SIMD_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+	namespace avx2
+	{
+		struct Int32Ops
+		{
+			using V = __m256i;
+			static constexpr size_t width = 8;
+
+			static V    zero()                          { return _mm256_setzero_si256(); }
+			static V    set1(int32_t value)             { return _mm256_set1_epi32(value); }
+			static V    load(const int32_t* data)       { return _mm256_loadu_si256(reinterpret_cast<const V*>(data)); }
+			static void store(int32_t* data, V value)   { _mm256_storeu_si256(reinterpret_cast<V*>(data), value); }
+			static V    add(V a, V b)                   { return _mm256_add_epi32(a, b); }
+			static V    min(V a, V b)                   { return _mm256_min_epi32(a, b); }
+			static V    max(V a, V b)                   { return _mm256_max_epi32(a, b); }
+			static int  equal_mask(V a, V b)            { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))); }
+		};
+
+		struct FloatOps
+		{
+			using V = __m256;
+			static constexpr size_t width = 8;
+
+			static V    zero()                          { return _mm256_setzero_ps(); }
+			static V    set1(float value)               { return _mm256_set1_ps(value); }
+			static V    load(const float* data)         { return _mm256_loadu_ps(data); }
+			static void store(float* data, V value)     { _mm256_storeu_ps(data, value); }
+			static V    add(V a, V b)                   { return _mm256_add_ps(a, b); }
+			static V    min(V a, V b)                   { return _mm256_min_ps(a, b); }
+			static V    max(V a, V b)                   { return _mm256_max_ps(a, b); }
+			static int  equal_mask(V a, V b)            { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+		};
+
+		struct DoubleOps
+		{
+			using V = __m256d;
+			static constexpr size_t width = 4;
+
+			static V    zero()                          { return _mm256_setzero_pd(); }
+			static V    set1(double value)              { return _mm256_set1_pd(value); }
+			static V    load(const double* data)        { return _mm256_loadu_pd(data); }
+			static void store(double* data, V value)    { _mm256_storeu_pd(data, value); }
+			static V    add(V a, V b)                   { return _mm256_add_pd(a, b); }
+			static V    min(V a, V b)                   { return _mm256_min_pd(a, b); }
+			static V    max(V a, V b)                   { return _mm256_max_pd(a, b); }
+			static int  equal_mask(V a, V b)            { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+		};
+
+#include "simdkernels.inc"
+	}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+	namespace sse41
+	{
+		struct Int32Ops
+		{
+			using V = __m128i;
+			static constexpr size_t width = 4;
+
+			static V    zero()                          { return _mm_setzero_si128(); }
+			static V    set1(int32_t value)             { return _mm_set1_epi32(value); }
+			static V    load(const int32_t* data)       { return _mm_loadu_si128(reinterpret_cast<const V*>(data)); }
+			static void store(int32_t* data, V value)   { _mm_storeu_si128(reinterpret_cast<V*>(data), value); }
+			static V    add(V a, V b)                   { return _mm_add_epi32(a, b); }
+			static V    min(V a, V b)                   { return _mm_min_epi32(a, b); }
+			static V    max(V a, V b)                   { return _mm_max_epi32(a, b); }
+			static int  equal_mask(V a, V b)            { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))); }
+		};
+
+		struct FloatOps
+		{
+			using V = __m128;
+			static constexpr size_t width = 4;
+
+			static V    zero()                          { return _mm_setzero_ps(); }
+			static V    set1(float value)               { return _mm_set1_ps(value); }
+			static V    load(const float* data)         { return _mm_loadu_ps(data); }
+			static void store(float* data, V value)     { _mm_storeu_ps(data, value); }
+			static V    add(V a, V b)                   { return _mm_add_ps(a, b); }
+			static V    min(V a, V b)                   { return _mm_min_ps(a, b); }
+			static V    max(V a, V b)                   { return _mm_max_ps(a, b); }
+			static int  equal_mask(V a, V b)            { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+		};
+
+		struct DoubleOps
+		{
+			using V = __m128d;
+			static constexpr size_t width = 2;
+
+			static V    zero()                          { return _mm_setzero_pd(); }
+			static V    set1(double value)              { return _mm_set1_pd(value); }
+			static V    load(const double* data)        { return _mm_loadu_pd(data); }
+			static void store(double* data, V value)    { _mm_storeu_pd(data, value); }
+			static V    add(V a, V b)                   { return _mm_add_pd(a, b); }
+			static V    min(V a, V b)                   { return _mm_min_pd(a, b); }
+			static V    max(V a, V b)                   { return _mm_max_pd(a, b); }
+			static int  equal_mask(V a, V b)            { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+		};
+
+#include "simdkernels.inc"
+	}
+
+#pragma GCC pop_options
+
+	// Maps an element type onto its Ops for a given instruction set, or void
+	// when the type has no vector path.
+	template <typename Set, typename T> struct ops_for           { using type = void; };
+	template <typename Set> struct ops_for<Set, int32_t>          { using type = typename Set::Int32Ops; };
+	template <typename Set> struct ops_for<Set, float>            { using type = typename Set::FloatOps; };
+	template <typename Set> struct ops_for<Set, double>           { using type = typename Set::DoubleOps; };
+
+	struct avx2_set
+	{
+		using Int32Ops  = avx2::Int32Ops;
+		using FloatOps  = avx2::FloatOps;
+		using DoubleOps = avx2::DoubleOps;
+	};
+
+	struct sse41_set
+	{
+		using Int32Ops  = sse41::Int32Ops;
+		using FloatOps  = sse41::FloatOps;
+		using DoubleOps = sse41::DoubleOps;
+	};
+
+	template <typename T>
+	constexpr bool has_vector_path = !std::is_void<typename ops_for<avx2_set, T>::type>::value;
+
+#define DS_SIMD_DISPATCH(name, ...)                                                             \
+	if constexpr (has_vector_path<T>)                                                            \
+	{                                                                                            \
+		switch (level())                                                                         \
+		{                                                                                        \
+		case Level::AVX2:  return avx2::name<typename ops_for<avx2_set, T>::type>(__VA_ARGS__);   \
+		case Level::SSE41: return sse41::name<typename ops_for<sse41_set, T>::type>(__VA_ARGS__); \
+		default:           break;                                                                \
+		}                                                                                        \
+	}                                                                                            \
+	return scalar::name(__VA_ARGS__);
+
+#else
+
+#define DS_SIMD_DISPATCH(name, ...) return scalar::name(__VA_ARGS__);
+
+#endif
+
+	// min and max require length > 0; find returns length when value is absent.
+	template <typename T>
+	T sum(const T* data, size_t length) { DS_SIMD_DISPATCH(sum, data, length) }
+
+	template <typename T>
+	T min(const T* data, size_t length) { DS_SIMD_DISPATCH(min, data, length) }
+
+	template <typename T>
+	T max(const T* data, size_t length) { DS_SIMD_DISPATCH(max, data, length) }
+
+	template <typename T>
+	size_t count(const T* data, size_t length, T value) { DS_SIMD_DISPATCH(count, data, length, value) }
+
+	template <typename T>
+	size_t find(const T* data, size_t length, T value) { DS_SIMD_DISPATCH(find, data, length, value) }
+
+	template <typename T>
+	void fill(T* data, size_t length, T value) { DS_SIMD_DISPATCH(fill, data, length, value) }
+
+#undef DS_SIMD_DISPATCH
+}
+
+#endif
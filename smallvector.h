@@ -0,0 +1,476 @@
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "exceptions.h"
+#include "lockpolicy.h"
+
+// Vector that keeps its first N elements inside the object and only moves
+// to the heap once it outgrows them. The API and locking mirror Vector.
+template <typename T, size_t N, typename Lock = RuntimeLock>
+class SmallVector
+{
+private:
+	static_assert(N > 0, "SmallVector needs an inline capacity of at least one element");
+
+	using Allocator       = std::allocator<T>;
+	using AllocatorTraits = std::allocator_traits<Allocator>;
+
+	size_t       capacity;
+	size_t       size;
+	Allocator    allocator;
+	T*           elements;
+	mutable Lock mutex;
+
+	alignas(T) unsigned char inline_storage[N * sizeof(T)];
+
+public:
+	SmallVector();
+
+	template <typename B, enable_if_bool<B> = 0>
+	explicit SmallVector(B is_thread_safe);
+	SmallVector(SmallVector&& other);
+	~SmallVector();
+
+	SmallVector& operator=(SmallVector&& other);
+	SmallVector& operator=(const SmallVector&) = delete;
+
+	void        swap(SmallVector& other);
+	SmallVector clone() const;
+
+	void reserve(size_t new_capacity);
+	void push_back(const T& element);
+	void push_back(T&& element);
+
+	template <typename... Args>
+	void emplace_back(Args&&... args);
+
+	template <typename InputIt>
+	void append(InputIt first, InputIt last);
+
+	T    pop();
+	T    at(int index) const;
+	void clear();
+
+	// Return std::nullopt where pop and at would throw.
+	std::optional<T> try_pop();
+	std::optional<T> try_at(int index) const;
+
+	template <typename Function>
+	decltype(auto) access(Function function);
+
+	template <typename Function>
+	decltype(auto) access(Function function) const;
+
+	size_t get_size() const;
+	size_t get_length() const;
+	size_t get_capacity() const;
+	bool   is_inline() const;
+
+	static constexpr size_t inline_capacity = N;
+
+	const T& operator[](int index) const;
+
+private:
+	SmallVector(const SmallVector& other);
+
+	T*   inline_elements();
+	bool uses_inline_storage() const;
+
+	void relocate(size_t new_capacity);
+	void destroy_elements();
+	void release_storage();
+	void take(SmallVector& other);
+
+	bool is_full() const;
+	bool is_empty() const;
+};
+
+template <typename T, size_t N, typename Lock>
+SmallVector<T, N, Lock>::SmallVector()
+	: capacity(N), size(0), elements(inline_elements())
+{
+}
+
+template <typename T, size_t N, typename Lock>
+template <typename B, enable_if_bool<B>>
+SmallVector<T, N, Lock>::SmallVector(B is_thread_safe)
+	: capacity(N), size(0), elements(inline_elements()), mutex(is_thread_safe)
+{
+}
+
+template <typename T, size_t N, typename Lock>
+SmallVector<T, N, Lock>::SmallVector(const SmallVector& other)
+	: capacity(N), size(0), elements(inline_elements()), mutex(other.mutex)
+{
+	std::shared_lock<Lock> lock(other.mutex);
+
+	DS_TRY
+	{
+		if (other.size > capacity)
+			relocate(other.size);
+
+		for (; size < other.size; ++size)
+			AllocatorTraits::construct(allocator, elements + size, other.elements[size]);
+	}
+	DS_CATCH_ALL
+	{
+		destroy_elements();
+		release_storage();
+		DS_RETHROW;
+	}
+}
+
+template <typename T, size_t N, typename Lock>
+SmallVector<T, N, Lock>::SmallVector(SmallVector&& other)
+	: capacity(N), size(0), elements(inline_elements()), mutex(other.mutex)
+{
+	std::lock_guard<Lock> lock(other.mutex);
+
+	take(other);
+}
+
+template <typename T, size_t N, typename Lock>
+SmallVector<T, N, Lock>::~SmallVector()
+{
+	destroy_elements();
+	release_storage();
+}
+
+template <typename T, size_t N, typename Lock>
+SmallVector<T, N, Lock>& SmallVector<T, N, Lock>::operator=(SmallVector&& other)
+{
+	if (this == &other)
+		return *this;
+
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	destroy_elements();
+	release_storage();
+	take(other);
+
+	return *this;
+}
+
+// Inline elements cannot trade places by pointer, so the swap goes through a
+// temporary.
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::swap(SmallVector& other)
+{
+	if (this == &other)
+		return;
+
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	SmallVector temp;
+	temp.take(*this);
+	take(other);
+	other.take(temp);
+}
+
+// Adopts other's heap buffer, or moves its inline elements one by one. This
+// vector must be empty and back on its inline storage.
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::take(SmallVector& other)
+{
+	if (other.uses_inline_storage())
+	{
+		for (; size < other.size; ++size)
+			AllocatorTraits::construct(allocator, elements + size, std::move(other.elements[size]));
+
+		other.destroy_elements();
+	}
+	else
+	{
+		capacity = other.capacity;
+		size     = other.size;
+		elements = other.elements;
+
+		other.capacity = N;
+		other.size     = 0;
+		other.elements = other.inline_elements();
+	}
+}
+
+template <typename T, size_t N, typename Lock>
+SmallVector<T, N, Lock> SmallVector<T, N, Lock>::clone() const
+{
+	return SmallVector(*this);
+}
+
+template <typename T, size_t N, typename Lock>
+T* SmallVector<T, N, Lock>::inline_elements()
+{
+	return reinterpret_cast<T*>(inline_storage);
+}
+
+template <typename T, size_t N, typename Lock>
+bool SmallVector<T, N, Lock>::uses_inline_storage() const
+{
+	return elements == reinterpret_cast<const T*>(inline_storage);
+}
+
+// Moves the elements into a heap buffer of new_capacity elements.
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::relocate(size_t new_capacity)
+{
+	T* buffer = AllocatorTraits::allocate(allocator, new_capacity);
+	size_t moved = 0;
+
+	DS_TRY
+	{
+		for (; moved < size; ++moved)
+			AllocatorTraits::construct(allocator, buffer + moved, std::move_if_noexcept(elements[moved]));
+	}
+	DS_CATCH_ALL
+	{
+		for (size_t i = 0; i < moved; ++i)
+			AllocatorTraits::destroy(allocator, buffer + i);
+
+		AllocatorTraits::deallocate(allocator, buffer, new_capacity);
+		DS_RETHROW;
+	}
+
+	size_t length = size;
+	destroy_elements();
+	release_storage();
+
+	capacity = new_capacity;
+	size     = length;
+	elements = buffer;
+}
+
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::destroy_elements()
+{
+	for (size_t i = 0; i < size; ++i)
+		AllocatorTraits::destroy(allocator, elements + i);
+
+	size = 0;
+}
+
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::release_storage()
+{
+	if (!uses_inline_storage())
+		AllocatorTraits::deallocate(allocator, elements, capacity);
+
+	capacity = N;
+	elements = inline_elements();
+}
+
+template <typename T, size_t N, typename Lock>
+bool SmallVector<T, N, Lock>::is_full() const
+{
+	return (size == capacity);
+}
+
+template <typename T, size_t N, typename Lock>
+bool SmallVector<T, N, Lock>::is_empty() const
+{
+	return (size == 0);
+}
+
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::reserve(size_t new_capacity)
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	if (new_capacity > capacity)
+		relocate(new_capacity);
+}
+
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::push_back(const T& element)
+{
+	emplace_back(element);
+}
+
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::push_back(T&& element)
+{
+	emplace_back(std::move(element));
+}
+
+template <typename T, size_t N, typename Lock>
+template <typename... Args>
+void SmallVector<T, N, Lock>::emplace_back(Args&&... args)
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	if (is_full())
+	{
+		// The arguments may refer into the buffer that is about to move.
+		T element(std::forward<Args>(args)...);
+		relocate(capacity * 2);
+		AllocatorTraits::construct(allocator, elements + size, std::move(element));
+	}
+	else
+	{
+		AllocatorTraits::construct(allocator, elements + size, std::forward<Args>(args)...);
+	}
+
+	size++;
+}
+
+// Takes the lock and grows the buffer at most once for a forward range. The
+// range must not point into this vector.
+template <typename T, size_t N, typename Lock>
+template <typename InputIt>
+void SmallVector<T, N, Lock>::append(InputIt first, InputIt last)
+{
+	using category = typename std::iterator_traits<InputIt>::iterator_category;
+
+	std::lock_guard<Lock> lock(mutex);
+
+	if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+	{
+		size_t count = std::distance(first, last);
+
+		if (size + count > capacity)
+			relocate(size + count > capacity * 2 ? size + count : capacity * 2);
+	}
+
+	for (; first != last; ++first, ++size)
+	{
+		if (is_full())
+			relocate(capacity * 2);
+
+		AllocatorTraits::construct(allocator, elements + size, *first);
+	}
+}
+
+template <typename T, size_t N, typename Lock>
+T SmallVector<T, N, Lock>::pop()
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	size--;
+	T popped_element = std::move(elements[size]);
+	AllocatorTraits::destroy(allocator, elements + size);
+
+	return popped_element;
+}
+
+template <typename T, size_t N, typename Lock>
+T SmallVector<T, N, Lock>::at(int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	if (index >= 0 && index < size)
+		return elements[index];
+	else
+		DS_THROW(std::out_of_range("Index out of range"));
+}
+
+template <typename T, size_t N, typename Lock>
+std::optional<T> SmallVector<T, N, Lock>::try_pop()
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	if (is_empty())
+		return std::nullopt;
+
+	size--;
+	std::optional<T> popped_element(std::move(elements[size]));
+	AllocatorTraits::destroy(allocator, elements + size);
+
+	return popped_element;
+}
+
+template <typename T, size_t N, typename Lock>
+std::optional<T> SmallVector<T, N, Lock>::try_at(int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	if (index >= 0 && index < size)
+		return elements[index];
+
+	return std::nullopt;
+}
+
+// Destroys the elements and returns to the inline storage.
+template <typename T, size_t N, typename Lock>
+void SmallVector<T, N, Lock>::clear()
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	destroy_elements();
+	release_storage();
+}
+
+template <typename T, size_t N, typename Lock>
+template <typename Function>
+decltype(auto) SmallVector<T, N, Lock>::access(Function function)
+{
+	std::lock_guard<Lock> lock(mutex);
+
+	return function(elements, size);
+}
+
+template <typename T, size_t N, typename Lock>
+template <typename Function>
+decltype(auto) SmallVector<T, N, Lock>::access(Function function) const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return function(static_cast<const T*>(elements), size);
+}
+
+template <typename T, size_t N, typename Lock>
+size_t SmallVector<T, N, Lock>::get_size() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return size * sizeof(T);
+}
+
+template <typename T, size_t N, typename Lock>
+size_t SmallVector<T, N, Lock>::get_length() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return size;
+}
+
+template <typename T, size_t N, typename Lock>
+size_t SmallVector<T, N, Lock>::get_capacity() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return capacity;
+}
+
+template <typename T, size_t N, typename Lock>
+bool SmallVector<T, N, Lock>::is_inline() const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	return uses_inline_storage();
+}
+
+template <typename T, size_t N, typename Lock>
+const T& SmallVector<T, N, Lock>::operator[](int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	if (index < 0 || index >= size)
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return elements[index];
+}
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "exceptions.h"
+
+// Bounded queue for exactly one producer thread and one consumer thread.
+// Each side owns one index and only reads the other's, so every operation
+// is a handful of loads and one release store, with no read-modify-write
+// and no retry loop.
+//
+// Each side also keeps its last reading of the other side's index and only
+// reloads it when that reading says the queue is full (or empty). The
+// shared cache lines therefore move between cores once per lap of the ring,
+// not once per element. push_bulk and pop_bulk go further and publish a
+// whole batch with a single store.
+template <typename T>
+class SPSCQueue
+{
+private:
+	struct Slot
+	{
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		T* element() { return reinterpret_cast<T*>(storage); }
+	};
+
+	size_t capacity;
+	Slot*  slots;
+
+	// Written by the producer.
+	alignas(64) std::atomic<size_t> tail;
+	size_t cached_head;
+
+	// Written by the consumer.
+	alignas(64) std::atomic<size_t> head;
+	size_t cached_tail;
+
+public:
+	explicit SPSCQueue(size_t capacity);
+	~SPSCQueue();
+
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	// Producer thread only.
+	bool try_push(const T& element);
+	bool try_push(T&& element);
+
+	template <typename... Args>
+	bool try_emplace(Args&&... args);
+
+	// Pushes as much of the range as fits and returns how many elements
+	// were pushed.
+	template <typename InputIt>
+	size_t push_bulk(InputIt first, InputIt last);
+
+	// Consumer thread only.
+	bool try_pop(T& element);
+
+	// Pops up to max_count elements into out and returns how many.
+	template <typename OutputIt>
+	size_t pop_bulk(OutputIt out, size_t max_count);
+
+	// Exact only while neither side is in an operation.
+	size_t get_size() const;
+	size_t get_length() const;
+	size_t get_capacity() const;
+	bool   is_empty() const;
+
+private:
+	size_t free_slots(size_t position, size_t wanted);
+	size_t filled_slots(size_t position, size_t wanted);
+};
+
+template <typename T>
+SPSCQueue<T>::SPSCQueue(size_t capacity)
+	: capacity(1), tail(0), cached_head(0), head(0), cached_tail(0)
+{
+	if (capacity == 0)
+		DS_THROW(std::invalid_argument("Capacity must be at least 1"));
+
+	while (this->capacity < capacity)
+		this->capacity *= 2;
+
+	slots = new Slot[this->capacity];
+}
+
+template <typename T>
+SPSCQueue<T>::~SPSCQueue()
+{
+	if constexpr (!std::is_trivially_destructible<T>::value)
+	{
+		size_t last = tail.load(std::memory_order_relaxed);
+
+		for (size_t position = head.load(std::memory_order_relaxed); position != last; position++)
+			slots[position & (capacity - 1)].element()->~T();
+	}
+
+	delete[] slots;
+}
+
+// Free slots at tail position, reloading head only if the cached value
+// shows fewer than wanted.
+template <typename T>
+size_t SPSCQueue<T>::free_slots(size_t position, size_t wanted)
+{
+	size_t available = capacity - (position - cached_head);
+
+	if (available < wanted)
+	{
+		cached_head = head.load(std::memory_order_acquire);
+		available = capacity - (position - cached_head);
+	}
+
+	return available;
+}
+
+template <typename T>
+size_t SPSCQueue<T>::filled_slots(size_t position, size_t wanted)
+{
+	size_t available = cached_tail - position;
+
+	if (available < wanted)
+	{
+		cached_tail = tail.load(std::memory_order_acquire);
+		available = cached_tail - position;
+	}
+
+	return available;
+}
+
+template <typename T>
+bool SPSCQueue<T>::try_push(const T& element)
+{
+	return try_emplace(element);
+}
+
+template <typename T>
+bool SPSCQueue<T>::try_push(T&& element)
+{
+	return try_emplace(std::move(element));
+}
+
+template <typename T>
+template <typename... Args>
+bool SPSCQueue<T>::try_emplace(Args&&... args)
+{
+	size_t position = tail.load(std::memory_order_relaxed);
+
+	if (!free_slots(position, 1))
+		return false;
+
+	::new (static_cast<void*>(slots[position & (capacity - 1)].storage)) T(std::forward<Args>(args)...);
+	tail.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+// If an element's constructor throws, the ones before it are still
+// published.
+template <typename T>
+template <typename InputIt>
+size_t SPSCQueue<T>::push_bulk(InputIt first, InputIt last)
+{
+	size_t position = tail.load(std::memory_order_relaxed);
+	size_t available = free_slots(position, capacity);
+	size_t pushed = 0;
+
+	DS_TRY
+	{
+		for (; first != last && pushed < available; ++first, ++pushed)
+			::new (static_cast<void*>(slots[(position + pushed) & (capacity - 1)].storage)) T(*first);
+	}
+	DS_CATCH_ALL
+	{
+		tail.store(position + pushed, std::memory_order_release);
+		DS_RETHROW;
+	}
+
+	tail.store(position + pushed, std::memory_order_release);
+
+	return pushed;
+}
+
+template <typename T>
+bool SPSCQueue<T>::try_pop(T& element)
+{
+	size_t position = head.load(std::memory_order_relaxed);
+
+	if (!filled_slots(position, 1))
+		return false;
+
+	T* slot = slots[position & (capacity - 1)].element();
+
+	DS_TRY
+	{
+		element = std::move(*slot);
+	}
+	DS_CATCH_ALL
+	{
+		slot->~T();
+		head.store(position + 1, std::memory_order_release);
+		DS_RETHROW;
+	}
+
+	slot->~T();
+	head.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <typename T>
+template <typename OutputIt>
+size_t SPSCQueue<T>::pop_bulk(OutputIt out, size_t max_count)
+{
+	size_t position = head.load(std::memory_order_relaxed);
+	size_t available = filled_slots(position, max_count);
+	size_t popped = 0;
+
+	if (available > max_count)
+		available = max_count;
+
+	DS_TRY
+	{
+		for (; popped < available; ++popped, ++out)
+		{
+			T* slot = slots[(position + popped) & (capacity - 1)].element();
+
+			*out = std::move(*slot);
+			slot->~T();
+		}
+	}
+	DS_CATCH_ALL
+	{
+		slots[(position + popped) & (capacity - 1)].element()->~T();
+		head.store(position + popped + 1, std::memory_order_release);
+		DS_RETHROW;
+	}
+
+	head.store(position + popped, std::memory_order_release);
+
+	return popped;
+}
+
+template <typename T>
+size_t SPSCQueue<T>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T>
+size_t SPSCQueue<T>::get_length() const
+{
+	size_t first = head.load(std::memory_order_relaxed);
+	size_t last = tail.load(std::memory_order_relaxed);
+
+	return last > first ? last - first : 0;
+}
+
+template <typename T>
+size_t SPSCQueue<T>::get_capacity() const
+{
+	return capacity;
+}
+
+template <typename T>
+bool SPSCQueue<T>::is_empty() const
+{
+	return get_length() == 0;
+}
+
+#endif
@@ -1,254 +1,842 @@
 #ifndef STACK_H
 #define STACK_H
 
-#include <functional>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-template <typename T>
+#include "exceptions.h"
+#include "lockpolicy.h"
+
+// What push does when the stack is at capacity.
+enum class StackOverflow
+{
+	Grow,            // reallocate to twice the capacity, moving the elements
+	GrowChunked,     // link another chunk of capacity elements; nothing moves
+	Reject,          // leave the stack unchanged and report false
+	Block,           // wait until a pop makes room
+	OverwriteOldest  // drop the bottom element to make room
+};
+
+// GrowChunked keeps the elements in a list of fixed-size chunks, so a push
+// never copies existing elements and costs O(1) in the worst case, at the
+// price of at() and operator[] walking the chunks. The bounded modes keep
+// capacity elements in one buffer, used as a ring by OverwriteOldest.
+// Every mode but Grow and Reject needs a capacity of at least one.
+template <typename T, typename Lock = RuntimeLock, typename Allocator = std::allocator<T>>
 class Stack
 {
 private:
-	size_t     capacity;
-	size_t     size;
-	T*         elements;
-	std::mutex mutex;
+	using AllocatorTraits = std::allocator_traits<Allocator>;
 
-public:
-	std::function<T()>            pop;
-	std::function<T()>            top;
-	std::function<void(const T&)> push;
-	std::function<T(int)>         at;
-	std::function<size_t()>       get_size;
-	std::function<size_t()>       get_length;
-	std::function<size_t()>       get_capacity;
+	struct Chunk
+	{
+		T*     elements;
+		Chunk* previous;
+		Chunk* next;
+	};
+
+	using ChunkAllocator       = typename AllocatorTraits::template rebind_alloc<Chunk>;
+	using ChunkAllocatorTraits = std::allocator_traits<ChunkAllocator>;
+
+	size_t        capacity;
+	size_t        size;
+	StackOverflow overflow;
+	Allocator     allocator;
+	T*            elements;
+	size_t        base;
+	Chunk*        chunks;
+	Chunk*        top_chunk;
+	size_t        chunk_count;
+	mutable Lock  mutex;
+
+	std::condition_variable_any not_full;
+	size_t                      blocked_pushers;
 
 public:
-	Stack(bool is_thread_safe);
-	Stack(size_t capacity, bool is_thread_safe);
+	explicit Stack(const Allocator& allocator = Allocator());
+	explicit Stack(size_t capacity, const Allocator& allocator = Allocator());
+	Stack(size_t capacity, StackOverflow overflow, const Allocator& allocator = Allocator());
+
+	template <typename B, enable_if_bool<B> = 0>
+	explicit Stack(B is_thread_safe, const Allocator& allocator = Allocator());
+
+	template <typename B, enable_if_bool<B> = 0>
+	Stack(size_t capacity, B is_thread_safe, const Allocator& allocator = Allocator());
+
+	template <typename B, enable_if_bool<B> = 0>
+	Stack(size_t capacity, StackOverflow overflow, B is_thread_safe, const Allocator& allocator = Allocator());
+
+	Stack(Stack&& other);
 	~Stack();
 
+	Stack& operator=(Stack&& other);
+	Stack& operator=(const Stack&) = delete;
+
+	void  swap(Stack& other);
+	Stack clone() const;
+
+	// push and emplace return false only when StackOverflow::Reject turned
+	// the element away.
+	T    pop();
+	T    top() const;
+	bool push(const T& element);
+	bool push(T&& element);
+	T    at(int index) const;
+
+	// Return std::nullopt where pop, top and at would throw.
+	std::optional<T> try_pop();
+	std::optional<T> try_top() const;
+	std::optional<T> try_at(int index) const;
+
+	size_t        get_size() const;
+	size_t        get_length() const;
+	size_t        get_capacity() const;
+	StackOverflow get_overflow() const;
+
+	Allocator get_allocator() const;
+
+	template <typename... Args>
+	bool emplace(Args&&... args);
+
+	template <typename InputIt>
+	size_t push_range(InputIt first, InputIt last);
+
 	const T& operator[](int index) const;
 
 private:
-	void initialize_functions(bool is_thread_safe);
-
-	bool is_full();
-	bool is_empty();
+	Stack(const Stack& other);
 
-	T thread_safe_pop();
-	T no_thread_safe_pop();
+	T*   slot_at(size_t index) const;
 
-	T thread_safe_top();
-	T no_thread_safe_top();
+	template <typename Function>
+	void for_each_slot(Function function) const;
 
-	void thread_safe_push(const T& element);
-	void no_thread_safe_push(const T& element);
+	void ensure_buffer();
+	T*   prepare_push(std::unique_lock<Lock>& lock);
+	void commit_push();
+	void remove_top();
 
-	T thread_safe_at(int index);
-	T no_thread_safe_at(int index);
+	void steal(Stack& other);
+	void destroy_elements();
+	void release_storage();
+	void relocate(size_t new_capacity);
 
-	size_t thread_safe_get_size();
-	size_t no_thread_safe_get_size();
+	Chunk* add_chunk();
+	void   free_chunk(Chunk* chunk);
 
-	size_t thread_safe_get_length();
-	size_t no_thread_safe_get_length();
+	T*   allocate(size_t count);
+	void deallocate(T* buffer, size_t count);
 
-	size_t thread_safe_get_capacity();
-	size_t no_thread_safe_get_capacity();
+	bool is_chunked() const;
+	bool is_full() const;
+	bool is_empty() const;
 };
 
-template <typename T>
-Stack<T>::Stack(bool is_thread_safe)
-	: capacity(10), size(0), elements(new T[capacity])
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>::Stack(const Allocator& allocator)
+	: Stack(10, StackOverflow::Grow, allocator)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>::Stack(size_t capacity, const Allocator& allocator)
+	: Stack(capacity, StackOverflow::Grow, allocator)
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>::Stack(size_t capacity, StackOverflow overflow, const Allocator& allocator)
+	: capacity(capacity), size(0), overflow(overflow), allocator(allocator), elements(nullptr), base(0),
+	  chunks(nullptr), top_chunk(nullptr), chunk_count(0), blocked_pushers(0)
+{
+	if (overflow != StackOverflow::Grow && overflow != StackOverflow::Reject && capacity == 0)
+		DS_THROW(std::invalid_argument("Capacity must be at least 1"));
+
+	if (!is_chunked())
+		elements = allocate(capacity);
+}
+
+template <typename T, typename Lock, typename Allocator>
+template <typename B, enable_if_bool<B>>
+Stack<T, Lock, Allocator>::Stack(B is_thread_safe, const Allocator& allocator)
+	: Stack(10, StackOverflow::Grow, is_thread_safe, allocator)
 {
-	initialize_functions(is_thread_safe);
 }
 
-template <typename T>
-Stack<T>::Stack(size_t capacity, bool is_thread_safe)
-	: capacity(capacity), size(0), elements(new T[capacity])
+template <typename T, typename Lock, typename Allocator>
+template <typename B, enable_if_bool<B>>
+Stack<T, Lock, Allocator>::Stack(size_t capacity, B is_thread_safe, const Allocator& allocator)
+	: Stack(capacity, StackOverflow::Grow, is_thread_safe, allocator)
 {
-	initialize_functions(is_thread_safe);
 }
 
-template <typename T>
-Stack<T>::~Stack()
+template <typename T, typename Lock, typename Allocator>
+template <typename B, enable_if_bool<B>>
+Stack<T, Lock, Allocator>::Stack(size_t capacity, StackOverflow overflow, B is_thread_safe, const Allocator& allocator)
+	: capacity(capacity), size(0), overflow(overflow), allocator(allocator), elements(nullptr), base(0),
+	  chunks(nullptr), top_chunk(nullptr), chunk_count(0), mutex(is_thread_safe), blocked_pushers(0)
+{
+	if (overflow != StackOverflow::Grow && overflow != StackOverflow::Reject && capacity == 0)
+		DS_THROW(std::invalid_argument("Capacity must be at least 1"));
+
+	if (!is_chunked())
+		elements = allocate(capacity);
+}
+
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>::Stack(const Stack& other)
+	: size(0), allocator(AllocatorTraits::select_on_container_copy_construction(other.allocator)), elements(nullptr),
+	  base(0), chunks(nullptr), top_chunk(nullptr), chunk_count(0), mutex(other.mutex), blocked_pushers(0)
+{
+	std::shared_lock<Lock> lock(other.mutex);
+
+	capacity = other.capacity;
+	overflow = other.overflow;
+
+	DS_TRY
+	{
+		if (!is_chunked())
+			elements = allocate(capacity);
+
+		other.for_each_slot([&](T* element)
+		{
+			std::unique_lock<Lock> unused;
+			AllocatorTraits::construct(allocator, prepare_push(unused), *element);
+			commit_push();
+		});
+	}
+	DS_CATCH_ALL
+	{
+		destroy_elements();
+		release_storage();
+		DS_RETHROW;
+	}
+}
+
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>::Stack(Stack&& other)
+	: allocator(other.allocator), mutex(other.mutex), blocked_pushers(0)
 {
-	delete[] elements;
+	std::lock_guard<Lock> lock(other.mutex);
+
+	steal(other);
 }
 
-template <typename T>
-const T& Stack<T>::operator[](int index) const
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>::~Stack()
 {
-	return at(index);
+	destroy_elements();
+	release_storage();
 }
 
-template <typename T>
-void Stack<T>::initialize_functions(bool is_thread_safe)
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator>& Stack<T, Lock, Allocator>::operator=(Stack&& other)
 {
-	if (is_thread_safe)
+	if (this == &other)
+		return *this;
+
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	destroy_elements();
+	release_storage();
+
+	if (AllocatorTraits::propagate_on_container_move_assignment::value || allocator == other.allocator)
 	{
-		pop          = [this]() { return this->thread_safe_pop(); };
-		top          = [this]() { return this->thread_safe_top(); };
-		push         = [this](const T& element) { this->thread_safe_push(element); };
-		at           = [this](int index) { return this->thread_safe_at(index); };
-		get_size     = [this]() { return this->thread_safe_get_size(); };
-		get_length   = [this]() { return this->thread_safe_get_length(); };
-		get_capacity = [this]() { return this->thread_safe_get_capacity(); };
+		if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value)
+			allocator = std::move(other.allocator);
+
+		steal(other);
 	}
 	else
 	{
-		pop          = [this]() { return this->no_thread_safe_pop(); };
-		top          = [this]() { return this->no_thread_safe_top(); };
-		push         = [this](const T& element) { this->no_thread_safe_push(element); };
-		at           = [this](int index) { return this->no_thread_safe_at(index); };
-		get_size     = [this]() { return this->no_thread_safe_get_size(); };
-		get_length   = [this]() { return this->no_thread_safe_get_length(); };
-		get_capacity = [this]() { return this->no_thread_safe_get_capacity(); };
+		// Our allocator cannot free other's storage, so the elements move one
+		// by one into storage we own.
+		capacity = other.capacity;
+		overflow = other.overflow;
+
+		if (!is_chunked())
+			elements = allocate(capacity);
+
+		other.for_each_slot([&](T* element)
+		{
+			std::unique_lock<Lock> unused;
+			AllocatorTraits::construct(allocator, prepare_push(unused), std::move(*element));
+			commit_push();
+		});
+
+		other.destroy_elements();
 	}
+
+	if (blocked_pushers)
+		not_full.notify_all();
+
+	return *this;
 }
 
-template <typename T>
-T Stack<T>::thread_safe_pop()
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::swap(Stack& other)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	if (this == &other)
+		return;
 
-	if (is_empty())
-		throw std::out_of_range("Index out of range");
+	PairLockGuard<Lock> lock(mutex, other.mutex);
+
+	if constexpr (AllocatorTraits::propagate_on_container_swap::value)
+		std::swap(allocator, other.allocator);
+	else if (!(allocator == other.allocator))
+		DS_THROW(std::invalid_argument("Cannot swap containers with unequal allocators"));
+
+	std::swap(capacity, other.capacity);
+	std::swap(size, other.size);
+	std::swap(overflow, other.overflow);
+	std::swap(elements, other.elements);
+	std::swap(base, other.base);
+	std::swap(chunks, other.chunks);
+	std::swap(top_chunk, other.top_chunk);
+	std::swap(chunk_count, other.chunk_count);
+
+	if (blocked_pushers)
+		not_full.notify_all();
+	if (other.blocked_pushers)
+		other.not_full.notify_all();
+}
 
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::steal(Stack& other)
+{
+	capacity    = other.capacity;
+	size        = other.size;
+	overflow    = other.overflow;
+	elements    = other.elements;
+	base        = other.base;
+	chunks      = other.chunks;
+	top_chunk   = other.top_chunk;
+	chunk_count = other.chunk_count;
+
+	other.capacity    = 0;
+	other.size        = 0;
+	other.elements    = nullptr;
+	other.base        = 0;
+	other.chunks      = nullptr;
+	other.top_chunk   = nullptr;
+	other.chunk_count = 0;
+
+	// A moved-from stack keeps its chunk size or bound so it stays usable;
+	// only Grow starts over from an empty buffer.
+	if (overflow != StackOverflow::Grow)
+		other.capacity = capacity;
+}
+
+template <typename T, typename Lock, typename Allocator>
+Stack<T, Lock, Allocator> Stack<T, Lock, Allocator>::clone() const
+{
+	return Stack(*this);
+}
+
+template <typename T, typename Lock, typename Allocator>
+bool Stack<T, Lock, Allocator>::is_chunked() const
+{
+	return overflow == StackOverflow::GrowChunked;
+}
+
+// Element index counts from the bottom of the stack.
+template <typename T, typename Lock, typename Allocator>
+T* Stack<T, Lock, Allocator>::slot_at(size_t index) const
+{
+	if (is_chunked())
+	{
+		Chunk* chunk = top_chunk;
+		for (size_t steps = (size - 1) / capacity - index / capacity; steps; --steps)
+			chunk = chunk->previous;
+
+		return chunk->elements + index % capacity;
+	}
+
+	size_t position = base + index;
+
+	return elements + (position < capacity ? position : position - capacity);
+}
+
+// Visits the elements from the bottom up without walking the chunks once per
+// element.
+template <typename T, typename Lock, typename Allocator>
+template <typename Function>
+void Stack<T, Lock, Allocator>::for_each_slot(Function function) const
+{
+	if (is_chunked())
+	{
+		Chunk* chunk = chunks;
+		for (size_t i = 0; i < size; chunk = chunk->next)
+		{
+			for (size_t offset = 0; offset < capacity && i < size; ++offset, ++i)
+				function(chunk->elements + offset);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < size; ++i)
+			function(slot_at(i));
+	}
+}
+
+// A moved-from bounded stack keeps its capacity but not its buffer, which is
+// allocated again by the next push.
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::ensure_buffer()
+{
+	if (!is_chunked() && !elements)
+		elements = allocate(capacity);
+}
+
+// Makes room for one more element according to the overflow policy and
+// returns where to construct it, or nullptr if it was rejected. Block mode
+// waits on lock, which must own the mutex.
+template <typename T, typename Lock, typename Allocator>
+T* Stack<T, Lock, Allocator>::prepare_push(std::unique_lock<Lock>& lock)
+{
+	ensure_buffer();
+
+	switch (overflow)
+	{
+	case StackOverflow::GrowChunked:
+	{
+		Chunk* chunk = top_chunk;
+
+		if (size % capacity == 0)
+		{
+			chunk = size ? top_chunk->next : chunks;
+			if (!chunk)
+				chunk = add_chunk();
+		}
+
+		return chunk->elements + size % capacity;
+	}
+
+	case StackOverflow::Grow:
+		if (is_full())
+			relocate(capacity ? capacity * 2 : 1);
+		break;
+
+	case StackOverflow::Reject:
+		if (is_full())
+			return nullptr;
+		break;
+
+	case StackOverflow::Block:
+		while (is_full())
+		{
+			blocked_pushers++;
+			not_full.wait(lock);
+			blocked_pushers--;
+		}
+		break;
+
+	case StackOverflow::OverwriteOldest:
+		if (is_full())
+		{
+			AllocatorTraits::destroy(allocator, slot_at(0));
+			base = base + 1 == capacity ? 0 : base + 1;
+			size--;
+		}
+		break;
+	}
+
+	return slot_at(size);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::commit_push()
+{
+	if (is_chunked() && size % capacity == 0)
+		top_chunk = size ? top_chunk->next : chunks;
+
+	size++;
+}
+
+// Destroys the top element. An emptied chunk is kept as a spare for the next
+// push; any chunk above it is freed, so crossing a chunk boundary back and
+// forth never allocates.
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::remove_top()
+{
+	AllocatorTraits::destroy(allocator, slot_at(size - 1));
 	size--;
-	T popped_element = elements[size];
-	elements[size] = T();
 
-	return popped_element;
+	if (is_chunked() && size % capacity == 0)
+	{
+		if (top_chunk->next)
+			free_chunk(top_chunk->next);
+
+		top_chunk = top_chunk->previous;
+	}
+
+	if (blocked_pushers)
+		not_full.notify_one();
+}
+
+template <typename T, typename Lock, typename Allocator>
+typename Stack<T, Lock, Allocator>::Chunk* Stack<T, Lock, Allocator>::add_chunk()
+{
+	ChunkAllocator chunk_allocator(allocator);
+
+	Chunk* chunk = ChunkAllocatorTraits::allocate(chunk_allocator, 1);
+
+	DS_TRY
+	{
+		chunk->elements = allocate(capacity);
+	}
+	DS_CATCH_ALL
+	{
+		ChunkAllocatorTraits::deallocate(chunk_allocator, chunk, 1);
+		DS_RETHROW;
+	}
+
+	chunk->next = nullptr;
+	chunk->previous = size ? top_chunk : nullptr;
+
+	if (chunk->previous)
+		chunk->previous->next = chunk;
+	else
+		chunks = chunk;
+
+	chunk_count++;
+
+	return chunk;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::free_chunk(Chunk* chunk)
+{
+	ChunkAllocator chunk_allocator(allocator);
+
+	if (chunk->previous)
+		chunk->previous->next = chunk->next;
+	else
+		chunks = chunk->next;
+
+	if (chunk->next)
+		chunk->next->previous = chunk->previous;
+
+	deallocate(chunk->elements, capacity);
+	ChunkAllocatorTraits::deallocate(chunk_allocator, chunk, 1);
+
+	chunk_count--;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::destroy_elements()
+{
+	for_each_slot([&](T* element) { AllocatorTraits::destroy(allocator, element); });
+
+	size = 0;
+	base = 0;
+	top_chunk = nullptr;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::release_storage()
+{
+	while (chunks)
+		free_chunk(chunks);
+
+	deallocate(elements, capacity);
+	elements = nullptr;
+
+	if (!is_chunked())
+		capacity = 0;
+}
+
+// Only used by StackOverflow::Grow, where the ring offset is always zero.
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::relocate(size_t new_capacity)
+{
+	T* buffer = allocate(new_capacity);
+	size_t moved = 0;
+
+	DS_TRY
+	{
+		if constexpr (std::is_trivially_copyable<T>::value)
+		{
+			if (size)
+				std::memcpy(buffer, elements, size * sizeof(T));
+
+			moved = size;
+		}
+		else
+		{
+			for (; moved < size; ++moved)
+				AllocatorTraits::construct(allocator, buffer + moved, std::move_if_noexcept(elements[moved]));
+		}
+	}
+	DS_CATCH_ALL
+	{
+		for (size_t i = 0; i < moved; ++i)
+			AllocatorTraits::destroy(allocator, buffer + i);
+
+		deallocate(buffer, new_capacity);
+		DS_RETHROW;
+	}
+
+	for (size_t i = 0; i < size; ++i)
+		AllocatorTraits::destroy(allocator, elements + i);
+
+	deallocate(elements, capacity);
+
+	elements = buffer;
+	capacity = new_capacity;
+}
+
+template <typename T, typename Lock, typename Allocator>
+T* Stack<T, Lock, Allocator>::allocate(size_t count)
+{
+	return count ? AllocatorTraits::allocate(allocator, count) : nullptr;
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Stack<T, Lock, Allocator>::deallocate(T* buffer, size_t count)
+{
+	if (buffer)
+		AllocatorTraits::deallocate(allocator, buffer, count);
+}
+
+template <typename T, typename Lock, typename Allocator>
+Allocator Stack<T, Lock, Allocator>::get_allocator() const
+{
+	return allocator;
+}
+
+template <typename T, typename Lock, typename Allocator>
+const T& Stack<T, Lock, Allocator>::operator[](int index) const
+{
+	std::shared_lock<Lock> lock(mutex);
+
+	if (index >= 0 && index < size)
+		return *slot_at(index);
+	else
+		DS_THROW(std::out_of_range("Index out of range"));
 }
 
-template <typename T>
-T Stack<T>::no_thread_safe_pop()
+template <typename T, typename Lock, typename Allocator>
+T Stack<T, Lock, Allocator>::pop()
 {
+	std::lock_guard<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	size--;
-	T popped_element = elements[size];
-	elements[size] = T();
+	T popped_element = std::move(*slot_at(size - 1));
+	remove_top();
 
 	return popped_element;
 }
 
-template <typename T>
-T Stack<T>::thread_safe_top()
+template <typename T, typename Lock, typename Allocator>
+T Stack<T, Lock, Allocator>::top() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 
-	return elements[size - 1];
+	return *slot_at(size - 1);
 }
 
-template <typename T>
-T Stack<T>::no_thread_safe_top()
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Stack<T, Lock, Allocator>::try_pop()
 {
+	std::lock_guard<Lock> lock(mutex);
+
 	if (is_empty())
-		throw std::out_of_range("Index out of range");
+		return std::nullopt;
 
-	return elements[size - 1];
+	std::optional<T> popped_element(std::move(*slot_at(size - 1)));
+	remove_top();
+
+	return popped_element;
 }
 
-template <typename T>
-void Stack<T>::thread_safe_push(const T& element)
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Stack<T, Lock, Allocator>::try_top() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
-	if (is_full())
-		return;
+	if (is_empty())
+		return std::nullopt;
 
-	elements[size++] = element;
+	return *slot_at(size - 1);
 }
 
-template <typename T>
-void Stack<T>::no_thread_safe_push(const T& element)
+template <typename T, typename Lock, typename Allocator>
+bool Stack<T, Lock, Allocator>::push(const T& element)
 {
-	if (is_full())
-		return;
+	return emplace(element);
+}
 
-	elements[size++] = element;
+template <typename T, typename Lock, typename Allocator>
+bool Stack<T, Lock, Allocator>::push(T&& element)
+{
+	return emplace(std::move(element));
 }
 
-template <typename T>
-T Stack<T>::thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+bool Stack<T, Lock, Allocator>::emplace(Args&&... args)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<Lock> lock(mutex);
 
-	if (index >= 0 && index < size)
-		return elements[index];
+	if (is_full() && (overflow == StackOverflow::Grow || overflow == StackOverflow::OverwriteOldest))
+	{
+		// The arguments may refer to an element that is about to move or be
+		// overwritten.
+		T element(std::forward<Args>(args)...);
+
+		T* slot = prepare_push(lock);
+		if (!slot)
+			return false;
+
+		AllocatorTraits::construct(allocator, slot, std::move(element));
+	}
 	else
-		throw std::out_of_range("Index out of range");
+	{
+		T* slot = prepare_push(lock);
+		if (!slot)
+			return false;
+
+		AllocatorTraits::construct(allocator, slot, std::forward<Args>(args)...);
+	}
+
+	commit_push();
+
+	return true;
+}
+
+// Pushes the range under a single lock, following the overflow policy for
+// each element, and returns how many elements were pushed. Only Reject can
+// stop short. The range must not point into this stack.
+template <typename T, typename Lock, typename Allocator>
+template <typename InputIt>
+size_t Stack<T, Lock, Allocator>::push_range(InputIt first, InputIt last)
+{
+	std::unique_lock<Lock> lock(mutex);
+
+	size_t pushed = 0;
+
+	if constexpr (std::is_pointer<InputIt>::value && std::is_trivially_copyable<T>::value &&
+	              std::is_same<std::remove_cv_t<std::remove_pointer_t<InputIt>>, T>::value)
+	{
+		if (overflow == StackOverflow::Grow || overflow == StackOverflow::Reject)
+		{
+			ensure_buffer();
+			pushed = static_cast<size_t>(last - first);
+
+			if (overflow == StackOverflow::Grow && size + pushed > capacity)
+				relocate(size + pushed > capacity * 2 ? size + pushed : capacity * 2);
+
+			if (pushed > capacity - size)
+				pushed = capacity - size;
+
+			if (pushed)
+				std::memcpy(elements + size, first, pushed * sizeof(T));
+
+			size += pushed;
+
+			return pushed;
+		}
+	}
+
+	for (; first != last; ++first, ++pushed)
+	{
+		T* slot = prepare_push(lock);
+		if (!slot)
+			break;
+
+		AllocatorTraits::construct(allocator, slot, *first);
+		commit_push();
+	}
+
+	return pushed;
 }
 
-template <typename T>
-T Stack<T>::no_thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+T Stack<T, Lock, Allocator>::at(int index) const
 {
+	std::shared_lock<Lock> lock(mutex);
+
 	if (index >= 0 && index < size)
-		return elements[index];
+		return *slot_at(index);
 	else
-		throw std::out_of_range("Index out of range");
+		DS_THROW(std::out_of_range("Index out of range"));
 }
 
-template <typename T>
-bool Stack<T>::is_full()
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Stack<T, Lock, Allocator>::try_at(int index) const
 {
-	return (size + 1 == capacity);
+	std::shared_lock<Lock> lock(mutex);
+
+	if (index >= 0 && index < size)
+		return *slot_at(index);
+
+	return std::nullopt;
 }
 
-template <typename T>
-bool Stack<T>::is_empty()
+template <typename T, typename Lock, typename Allocator>
+bool Stack<T, Lock, Allocator>::is_full() const
 {
-	return (size == 0);
+	return !is_chunked() && size == capacity;
 }
 
-template <typename T>
-size_t Stack<T>::thread_safe_get_size()
+template <typename T, typename Lock, typename Allocator>
+bool Stack<T, Lock, Allocator>::is_empty() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
-
-	return size * sizeof(T);
+	return (size == 0);
 }
 
-template <typename T>
-size_t Stack<T>::no_thread_safe_get_size()
+template <typename T, typename Lock, typename Allocator>
+size_t Stack<T, Lock, Allocator>::get_size() const
 {
+	std::shared_lock<Lock> lock(mutex);
+
 	return size * sizeof(T);
 }
 
-template <typename T>
-size_t Stack<T>::thread_safe_get_length()
+template <typename T, typename Lock, typename Allocator>
+size_t Stack<T, Lock, Allocator>::get_length() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
 	return size;
 }
 
-template <typename T>
-size_t Stack<T>::no_thread_safe_get_length()
+// For GrowChunked, the number of elements the allocated chunks can hold.
+template <typename T, typename Lock, typename Allocator>
+size_t Stack<T, Lock, Allocator>::get_capacity() const
 {
-	return size;
+	std::shared_lock<Lock> lock(mutex);
+
+	return is_chunked() ? chunk_count * capacity : capacity;
 }
 
-template <typename T>
-size_t Stack<T>::thread_safe_get_capacity()
+template <typename T, typename Lock, typename Allocator>
+StackOverflow Stack<T, Lock, Allocator>::get_overflow() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<Lock> lock(mutex);
 
-	return capacity;
+	return overflow;
 }
 
-template <typename T>
-size_t Stack<T>::no_thread_safe_get_capacity()
+namespace pmr
 {
-	return capacity;
+	template <typename T, typename Lock = RuntimeLock>
+	using Stack = ::Stack<T, Lock, std::pmr::polymorphic_allocator<T>>;
 }
 
-#endif
\ No newline at end of file
+#endif
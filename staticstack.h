@@ -0,0 +1,202 @@
+#ifndef STATICSTACK_H
+#define STATICSTACK_H
+
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "exceptions.h"
+#include "staticstorage.h"
+
+// Stack with a fixed capacity of N elements stored inside the object. Unlike
+// Stack, a push onto a full StaticStack is never silently dropped: push
+// throws std::length_error and try_push returns false. Not synchronized;
+// usable in constant expressions for trivially copyable T.
+template <typename T, size_t N>
+class StaticStack
+{
+private:
+	StaticStorage<T, N> storage;
+
+public:
+	constexpr StaticStack() = default;
+
+	constexpr void push(const T& element);
+	constexpr void push(T&& element);
+	constexpr bool try_push(const T& element);
+	constexpr bool try_push(T&& element);
+
+	template <typename... Args>
+	constexpr void emplace(Args&&... args);
+
+	template <typename... Args>
+	constexpr bool try_emplace(Args&&... args);
+
+	constexpr T    pop();
+	constexpr T    top() const;
+	constexpr T    at(int index) const;
+	constexpr void clear();
+
+	// Return std::nullopt where pop, top and at would throw.
+	constexpr std::optional<T> try_pop();
+	constexpr std::optional<T> try_top() const;
+	constexpr std::optional<T> try_at(int index) const;
+
+	constexpr size_t get_size() const;
+	constexpr size_t get_length() const;
+	constexpr bool   is_full() const;
+	constexpr bool   is_empty() const;
+
+	static constexpr size_t get_capacity() { return N; }
+
+	constexpr const T& operator[](int index) const;
+};
+
+template <typename T, size_t N>
+constexpr void StaticStack<T, N>::push(const T& element)
+{
+	emplace(element);
+}
+
+template <typename T, size_t N>
+constexpr void StaticStack<T, N>::push(T&& element)
+{
+	emplace(std::move(element));
+}
+
+template <typename T, size_t N>
+constexpr bool StaticStack<T, N>::try_push(const T& element)
+{
+	return try_emplace(element);
+}
+
+template <typename T, size_t N>
+constexpr bool StaticStack<T, N>::try_push(T&& element)
+{
+	return try_emplace(std::move(element));
+}
+
+template <typename T, size_t N>
+template <typename... Args>
+constexpr void StaticStack<T, N>::emplace(Args&&... args)
+{
+	if (!try_emplace(std::forward<Args>(args)...))
+		DS_THROW(std::length_error("Capacity exceeded"));
+}
+
+template <typename T, size_t N>
+template <typename... Args>
+constexpr bool StaticStack<T, N>::try_emplace(Args&&... args)
+{
+	if (is_full())
+		return false;
+
+	storage.construct(storage.size, std::forward<Args>(args)...);
+	storage.size++;
+
+	return true;
+}
+
+template <typename T, size_t N>
+constexpr T StaticStack<T, N>::pop()
+{
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	storage.size--;
+	T popped_element = std::move(storage.data()[storage.size]);
+	storage.destroy(storage.size);
+
+	return popped_element;
+}
+
+template <typename T, size_t N>
+constexpr T StaticStack<T, N>::top() const
+{
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return storage.data()[storage.size - 1];
+}
+
+template <typename T, size_t N>
+constexpr T StaticStack<T, N>::at(int index) const
+{
+	if (index >= 0 && index < storage.size)
+		return storage.data()[index];
+	else
+		DS_THROW(std::out_of_range("Index out of range"));
+}
+
+template <typename T, size_t N>
+constexpr std::optional<T> StaticStack<T, N>::try_pop()
+{
+	if (is_empty())
+		return std::nullopt;
+
+	storage.size--;
+	std::optional<T> popped_element(std::move(storage.data()[storage.size]));
+	storage.destroy(storage.size);
+
+	return popped_element;
+}
+
+template <typename T, size_t N>
+constexpr std::optional<T> StaticStack<T, N>::try_top() const
+{
+	if (is_empty())
+		return std::nullopt;
+
+	return storage.data()[storage.size - 1];
+}
+
+template <typename T, size_t N>
+constexpr std::optional<T> StaticStack<T, N>::try_at(int index) const
+{
+	if (index >= 0 && index < storage.size)
+		return storage.data()[index];
+
+	return std::nullopt;
+}
+
+template <typename T, size_t N>
+constexpr void StaticStack<T, N>::clear()
+{
+	storage.clear();
+}
+
+template <typename T, size_t N>
+constexpr size_t StaticStack<T, N>::get_size() const
+{
+	return storage.size * sizeof(T);
+}
+
+template <typename T, size_t N>
+constexpr size_t StaticStack<T, N>::get_length() const
+{
+	return storage.size;
+}
+
+template <typename T, size_t N>
+constexpr bool StaticStack<T, N>::is_full() const
+{
+	return (storage.size == N);
+}
+
+template <typename T, size_t N>
+constexpr bool StaticStack<T, N>::is_empty() const
+{
+	return (storage.size == 0);
+}
+
+template <typename T, size_t N>
+constexpr const T& StaticStack<T, N>::operator[](int index) const
+{
+	if (index < 0 || index >= storage.size)
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return storage.data()[index];
+}
+
+#endif
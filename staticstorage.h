@@ -0,0 +1,125 @@
+#ifndef STATICSTORAGE_H
+#define STATICSTORAGE_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "exceptions.h"
+
+// In-object element storage for StaticVector and StaticStack: room for N
+// elements plus the count of live ones. Trivially copyable, default
+// constructible types get a plain array so the containers stay literal
+// types and work in constant expressions; everything else gets raw aligned
+// bytes and placement new.
+template <typename T, size_t N, bool = std::is_trivially_copyable<T>::value && std::is_default_constructible<T>::value>
+struct StaticStorage
+{
+	T      elements[N > 0 ? N : 1] = {};
+	size_t size = 0;
+
+	constexpr T*       data()       { return elements; }
+	constexpr const T* data() const { return elements; }
+
+	template <typename... Args>
+	constexpr void construct(size_t index, Args&&... args)
+	{
+		elements[index] = T(std::forward<Args>(args)...);
+	}
+
+	constexpr void destroy(size_t) { }
+
+	constexpr void clear()
+	{
+		size = 0;
+	}
+};
+
+template <typename T, size_t N>
+struct StaticStorage<T, N, false>
+{
+	alignas(T) unsigned char bytes[(N > 0 ? N : 1) * sizeof(T)];
+	size_t size = 0;
+
+	StaticStorage() = default;
+
+	StaticStorage(const StaticStorage& other)
+	{
+		DS_TRY
+		{
+			for (; size < other.size; ++size)
+				construct(size, other.data()[size]);
+		}
+		DS_CATCH_ALL
+		{
+			clear();
+			DS_RETHROW;
+		}
+	}
+
+	StaticStorage(StaticStorage&& other)
+	{
+		DS_TRY
+		{
+			for (; size < other.size; ++size)
+				construct(size, std::move(other.data()[size]));
+		}
+		DS_CATCH_ALL
+		{
+			clear();
+			DS_RETHROW;
+		}
+	}
+
+	StaticStorage& operator=(const StaticStorage& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			for (; size < other.size; ++size)
+				construct(size, other.data()[size]);
+		}
+
+		return *this;
+	}
+
+	StaticStorage& operator=(StaticStorage&& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			for (; size < other.size; ++size)
+				construct(size, std::move(other.data()[size]));
+		}
+
+		return *this;
+	}
+
+	~StaticStorage()
+	{
+		clear();
+	}
+
+	T*       data()       { return reinterpret_cast<T*>(bytes); }
+	const T* data() const { return reinterpret_cast<const T*>(bytes); }
+
+	template <typename... Args>
+	void construct(size_t index, Args&&... args)
+	{
+		::new (static_cast<void*>(bytes + index * sizeof(T))) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(size_t index)
+	{
+		data()[index].~T();
+	}
+
+	void clear()
+	{
+		while (size)
+			destroy(--size);
+	}
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef STATICVECTOR_H
+#define STATICVECTOR_H
+
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "exceptions.h"
+#include "staticstorage.h"
+
+// Vector with a fixed capacity of N elements stored inside the object, so it
+// never touches the heap. push_back throws std::length_error when full and
+// try_push_back reports it instead. It is not synchronized: it is meant for
+// a single owner, typically on the stack, and is usable in constant
+// expressions for trivially copyable T.
+template <typename T, size_t N>
+class StaticVector
+{
+private:
+	StaticStorage<T, N> storage;
+
+public:
+	constexpr StaticVector() = default;
+
+	constexpr void push_back(const T& element);
+	constexpr void push_back(T&& element);
+	constexpr bool try_push_back(const T& element);
+	constexpr bool try_push_back(T&& element);
+
+	template <typename... Args>
+	constexpr void emplace_back(Args&&... args);
+
+	template <typename... Args>
+	constexpr bool try_emplace_back(Args&&... args);
+
+	constexpr T    pop();
+	constexpr T    at(int index) const;
+	constexpr void clear();
+
+	// Return std::nullopt where pop and at would throw.
+	constexpr std::optional<T> try_pop();
+	constexpr std::optional<T> try_at(int index) const;
+
+	template <typename Function>
+	constexpr decltype(auto) access(Function function);
+
+	template <typename Function>
+	constexpr decltype(auto) access(Function function) const;
+
+	constexpr size_t get_size() const;
+	constexpr size_t get_length() const;
+	constexpr bool   is_full() const;
+	constexpr bool   is_empty() const;
+
+	static constexpr size_t get_capacity() { return N; }
+
+	constexpr const T& operator[](int index) const;
+};
+
+template <typename T, size_t N>
+constexpr void StaticVector<T, N>::push_back(const T& element)
+{
+	emplace_back(element);
+}
+
+template <typename T, size_t N>
+constexpr void StaticVector<T, N>::push_back(T&& element)
+{
+	emplace_back(std::move(element));
+}
+
+template <typename T, size_t N>
+constexpr bool StaticVector<T, N>::try_push_back(const T& element)
+{
+	return try_emplace_back(element);
+}
+
+template <typename T, size_t N>
+constexpr bool StaticVector<T, N>::try_push_back(T&& element)
+{
+	return try_emplace_back(std::move(element));
+}
+
+template <typename T, size_t N>
+template <typename... Args>
+constexpr void StaticVector<T, N>::emplace_back(Args&&... args)
+{
+	if (!try_emplace_back(std::forward<Args>(args)...))
+		DS_THROW(std::length_error("Capacity exceeded"));
+}
+
+template <typename T, size_t N>
+template <typename... Args>
+constexpr bool StaticVector<T, N>::try_emplace_back(Args&&... args)
+{
+	if (is_full())
+		return false;
+
+	storage.construct(storage.size, std::forward<Args>(args)...);
+	storage.size++;
+
+	return true;
+}
+
+template <typename T, size_t N>
+constexpr T StaticVector<T, N>::pop()
+{
+	if (is_empty())
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	storage.size--;
+	T popped_element = std::move(storage.data()[storage.size]);
+	storage.destroy(storage.size);
+
+	return popped_element;
+}
+
+template <typename T, size_t N>
+constexpr T StaticVector<T, N>::at(int index) const
+{
+	if (index >= 0 && index < storage.size)
+		return storage.data()[index];
+	else
+		DS_THROW(std::out_of_range("Index out of range"));
+}
+
+template <typename T, size_t N>
+constexpr std::optional<T> StaticVector<T, N>::try_pop()
+{
+	if (is_empty())
+		return std::nullopt;
+
+	storage.size--;
+	std::optional<T> popped_element(std::move(storage.data()[storage.size]));
+	storage.destroy(storage.size);
+
+	return popped_element;
+}
+
+template <typename T, size_t N>
+constexpr std::optional<T> StaticVector<T, N>::try_at(int index) const
+{
+	if (index >= 0 && index < storage.size)
+		return storage.data()[index];
+
+	return std::nullopt;
+}
+
+template <typename T, size_t N>
+constexpr void StaticVector<T, N>::clear()
+{
+	storage.clear();
+}
+
+template <typename T, size_t N>
+template <typename Function>
+constexpr decltype(auto) StaticVector<T, N>::access(Function function)
+{
+	return function(storage.data(), storage.size);
+}
+
+template <typename T, size_t N>
+template <typename Function>
+constexpr decltype(auto) StaticVector<T, N>::access(Function function) const
+{
+	return function(storage.data(), storage.size);
+}
+
+template <typename T, size_t N>
+constexpr size_t StaticVector<T, N>::get_size() const
+{
+	return storage.size * sizeof(T);
+}
+
+template <typename T, size_t N>
+constexpr size_t StaticVector<T, N>::get_length() const
+{
+	return storage.size;
+}
+
+template <typename T, size_t N>
+constexpr bool StaticVector<T, N>::is_full() const
+{
+	return (storage.size == N);
+}
+
+template <typename T, size_t N>
+constexpr bool StaticVector<T, N>::is_empty() const
+{
+	return (storage.size == 0);
+}
+
+template <typename T, size_t N>
+constexpr const T& StaticVector<T, N>::operator[](int index) const
+{
+	if (index < 0 || index >= storage.size)
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return storage.data()[index];
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "queue.h"
+
+// Fixed-size pool of worker threads fed from one task queue. Tasks must not
+// block waiting on other tasks of the same pool.
+class ThreadPool
+{
+private:
+	std::vector<std::thread>             workers;
+	Queue<std::function<void()>, NoLock> tasks;
+	std::mutex                           mutex;
+	std::condition_variable              task_available;
+	bool                                 is_stopping;
+
+public:
+	explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template <typename Function>
+	std::future<std::invoke_result_t<Function>> submit(Function function);
+
+	size_t get_size() const;
+
+private:
+	void work();
+};
+
+inline ThreadPool::ThreadPool(size_t thread_count)
+	: is_stopping(false)
+{
+	if (thread_count == 0)
+		thread_count = 1;
+
+	workers.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; i++)
+		workers.emplace_back([this]() { work(); });
+}
+
+inline ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+	}
+
+	task_available.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+template <typename Function>
+std::future<std::invoke_result_t<Function>> ThreadPool::submit(Function function)
+{
+	using Result = std::invoke_result_t<Function>;
+
+	// std::function needs a copyable target, so the packaged_task is shared.
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+	std::future<Result> result = task->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.emplace([task]() { (*task)(); });
+	}
+
+	task_available.notify_one();
+
+	return result;
+}
+
+inline size_t ThreadPool::get_size() const
+{
+	return workers.size();
+}
+
+inline void ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			task_available.wait(lock, [this]() { return is_stopping || tasks.get_length() > 0; });
+
+			if (tasks.get_length() == 0)
+				return;
+
+			task = tasks.pop();
+		}
+
+		task();
+	}
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef TWOLOCKQUEUE_H
+#define TWOLOCKQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "exceptions.h"
+#include "lockpolicy.h"
+
+// Linked queue with one lock for each end. head always points at a sentinel
+// node whose element has already been popped, so push only touches tail and
+// pop only touches head, and one producer and one consumer never wait on
+// each other. The one node both ends can see is the sentinel's successor
+// while the queue is empty, and its link is atomic.
+template <typename T, typename Lock = RuntimeLock>
+class TwoLockQueue
+{
+private:
+	struct Node
+	{
+		std::atomic<Node*> next;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		Node() : next(nullptr) { }
+
+		T& data() { return *reinterpret_cast<T*>(storage); }
+	};
+
+	alignas(64) Node* head;
+	mutable Lock      head_mutex;
+
+	alignas(64) Node* tail;
+	Lock              tail_mutex;
+
+	alignas(64) std::atomic<size_t> size;
+
+public:
+	TwoLockQueue();
+
+	template <typename B, enable_if_bool<B> = 0>
+	explicit TwoLockQueue(B is_thread_safe);
+	~TwoLockQueue();
+
+	TwoLockQueue(const TwoLockQueue&) = delete;
+	TwoLockQueue& operator=(const TwoLockQueue&) = delete;
+
+	T    pop();
+	bool try_pop(T& element);
+	T    front() const;
+
+	// Returns std::nullopt where front would throw.
+	std::optional<T> try_front() const;
+	void push(const T& element);
+	void push(T&& element);
+
+	template <typename... Args>
+	void emplace(Args&&... args);
+
+	// Counts a push from the moment it starts, so it may run ahead of what
+	// pop can see but never behind.
+	size_t get_size() const;
+	size_t get_length() const;
+	bool   is_empty() const;
+};
+
+template <typename T, typename Lock>
+TwoLockQueue<T, Lock>::TwoLockQueue()
+	: head(new Node()), tail(head), size(0)
+{
+}
+
+template <typename T, typename Lock>
+template <typename B, enable_if_bool<B>>
+TwoLockQueue<T, Lock>::TwoLockQueue(B is_thread_safe)
+	: head(new Node()), head_mutex(is_thread_safe), tail(head), tail_mutex(is_thread_safe), size(0)
+{
+}
+
+template <typename T, typename Lock>
+TwoLockQueue<T, Lock>::~TwoLockQueue()
+{
+	Node* node = head->next.load(std::memory_order_relaxed);
+	delete head;
+
+	while (node)
+	{
+		Node* next = node->next.load(std::memory_order_relaxed);
+		node->data().~T();
+		delete node;
+		node = next;
+	}
+}
+
+template <typename T, typename Lock>
+void TwoLockQueue<T, Lock>::push(const T& element)
+{
+	emplace(element);
+}
+
+template <typename T, typename Lock>
+void TwoLockQueue<T, Lock>::push(T&& element)
+{
+	emplace(std::move(element));
+}
+
+// The node is built before taking the lock, so the critical section is two
+// pointer stores.
+template <typename T, typename Lock>
+template <typename... Args>
+void TwoLockQueue<T, Lock>::emplace(Args&&... args)
+{
+	Node* node = new Node();
+
+	DS_TRY
+	{
+		::new (static_cast<void*>(node->storage)) T(std::forward<Args>(args)...);
+	}
+	DS_CATCH_ALL
+	{
+		delete node;
+		DS_RETHROW;
+	}
+
+	size.fetch_add(1, std::memory_order_relaxed);
+
+	std::lock_guard<Lock> lock(tail_mutex);
+
+	tail->next.store(node, std::memory_order_release);
+	tail = node;
+}
+
+template <typename T, typename Lock>
+T TwoLockQueue<T, Lock>::pop()
+{
+	std::unique_lock<Lock> lock(head_mutex);
+
+	Node* first = head;
+	Node* next = first->next.load(std::memory_order_acquire);
+
+	if (!next)
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	// next becomes the sentinel, so its element goes.
+	T popped_element = std::move(next->data());
+	next->data().~T();
+	head = next;
+
+	lock.unlock();
+
+	size.fetch_sub(1, std::memory_order_relaxed);
+	delete first;
+
+	return popped_element;
+}
+
+template <typename T, typename Lock>
+bool TwoLockQueue<T, Lock>::try_pop(T& element)
+{
+	Node* first;
+
+	{
+		std::lock_guard<Lock> lock(head_mutex);
+
+		first = head;
+		Node* next = first->next.load(std::memory_order_acquire);
+
+		if (!next)
+			return false;
+
+		element = std::move(next->data());
+		next->data().~T();
+		head = next;
+	}
+
+	size.fetch_sub(1, std::memory_order_relaxed);
+	delete first;
+
+	return true;
+}
+
+template <typename T, typename Lock>
+T TwoLockQueue<T, Lock>::front() const
+{
+	std::shared_lock<Lock> lock(head_mutex);
+
+	Node* next = head->next.load(std::memory_order_acquire);
+
+	if (!next)
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return next->data();
+}
+
+template <typename T, typename Lock>
+std::optional<T> TwoLockQueue<T, Lock>::try_front() const
+{
+	std::shared_lock<Lock> lock(head_mutex);
+
+	Node* next = head->next.load(std::memory_order_acquire);
+
+	if (!next)
+		return std::nullopt;
+
+	return next->data();
+}
+
+template <typename T, typename Lock>
+size_t TwoLockQueue<T, Lock>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T, typename Lock>
+size_t TwoLockQueue<T, Lock>::get_length() const
+{
+	return size.load(std::memory_order_relaxed);
+}
+
+template <typename T, typename Lock>
+bool TwoLockQueue<T, Lock>::is_empty() const
+{
+	std::shared_lock<Lock> lock(head_mutex);
+
+	return head->next.load(std::memory_order_acquire) == nullptr;
+}
+
+#endif
@@ -1,271 +1,705 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
-#include <functional>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
 #include <stdexcept>
-
-template <typename T>
+#include <type_traits>
+#include <utility>
+
+#include "exceptions.h"
+#include "lockpolicy.h"
+#include "simd.h"
+
+// With the default std::allocator the buffer comes from malloc so that
+// trivially copyable elements can grow through realloc; any other allocator
+// (e.g. pmr::Vector below), and std::allocator for over-aligned types, is
+// used through std::allocator_traits.
+template <typename T, typename Lock = RuntimeLock, typename Allocator = std::allocator<T>>
 class Vector
 {
 private:
-    size_t     capacity;
-    size_t     size;
-    int        increase;
-    T*         elements;
-    std::mutex mutex;
+    using AllocatorTraits = std::allocator_traits<Allocator>;
 
-public:
-    std::function<void(const T&)> push_back;
-    std::function<T()>            pop;
-    std::function<T(int)>         at;
-    std::function<size_t()>       get_size;
-    std::function<size_t()>       get_length;
-    std::function<size_t()>       get_capacity;
-    std::function<int()>       get_increase;
+    static constexpr bool uses_malloc = std::is_same<Allocator, std::allocator<T>>::value && alignof(T) <= alignof(std::max_align_t);
+
+    size_t       capacity;
+    size_t       size;
+    int          increase;
+    double       growth_factor;
+    Allocator    allocator;
+    T*           elements;
+    mutable Lock mutex;
 
 public:
-    Vector(bool is_thread_safe);
-    Vector(size_t capacity, bool is_thread_safe);
-    Vector(size_t capacity, int increase, bool is_thread_safe);
+    explicit Vector(const Allocator& allocator = Allocator());
+    explicit Vector(size_t capacity, const Allocator& allocator = Allocator());
+    Vector(size_t capacity, int increase, const Allocator& allocator = Allocator());
+
+    template <typename B, enable_if_bool<B> = 0>
+    explicit Vector(B is_thread_safe, const Allocator& allocator = Allocator());
+    Vector(size_t capacity, bool is_thread_safe, const Allocator& allocator = Allocator());
+    Vector(size_t capacity, int increase, bool is_thread_safe, const Allocator& allocator = Allocator());
+    Vector(Vector&& other);
     ~Vector();
 
+    Vector& operator=(Vector&& other);
+    Vector& operator=(const Vector&) = delete;
+
+    void   swap(Vector& other);
+    Vector clone() const;
+
+    void reserve(size_t new_capacity);
+    void push_back(const T& element);
+    void push_back(T&& element);
+
+    template <typename... Args>
+    void emplace_back(Args&&... args);
+
+    template <typename InputIt>
+    void append(InputIt first, InputIt last);
+
+    T    pop();
+    T    at(int index) const;
+
+    // Return std::nullopt where pop and at would throw.
+    std::optional<T> try_pop();
+    std::optional<T> try_at(int index) const;
+
+    T      sum() const;
+    T      min() const;
+    T      max() const;
+    int    find(const T& value) const;
+    size_t count(const T& value) const;
+    void   fill(const T& value);
+
+    template <typename Function>
+    void transform(Function function);
+
+    template <typename Function>
+    decltype(auto) access(Function function);
+
+    template <typename Function>
+    decltype(auto) access(Function function) const;
+
+    size_t get_size() const;
+    size_t get_length() const;
+    size_t get_capacity() const;
+    int    get_increase() const;
+    double get_growth_factor() const;
+    void   set_growth_factor(double factor);
+
+    Allocator get_allocator() const;
+
     const T& operator[](int index) const;
 
 private:
-    void initialize_functions(bool is_thread_safe);
-    void increase_capacity();
+    Vector(const Vector& other);
 
-    bool is_full();
-    bool is_empty();
+    void increase_capacity(size_t minimum_capacity);
+    void relocate(size_t new_capacity);
 
-    void thread_safe_push_back(const T& element);
-    void no_thread_safe_push_back(const T& element);
+    void destroy_elements();
+    void steal(Vector& other);
 
-    T thread_safe_pop();
-    T no_thread_safe_pop();
+    T*   allocate(size_t count);
+    void deallocate(T* buffer, size_t count);
 
-    T thread_safe_at(int index);
-    T no_thread_safe_at(int index);
+    bool is_full() const;
+    bool is_empty() const;
+};
 
-    size_t thread_safe_size();
-    size_t no_thread_safe_size();
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(const Allocator& allocator)
+    : capacity(10), size(0), increase(capacity / 2), growth_factor(2.0), allocator(allocator), elements(allocate(capacity))
+{
+}
 
-    size_t thread_safe_length();
-    size_t no_thread_safe_length();
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(size_t capacity, const Allocator& allocator)
+    : capacity(capacity), size(0), increase(capacity / 2), growth_factor(2.0), allocator(allocator), elements(allocate(capacity))
+{
+}
+
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(size_t capacity, int increase, const Allocator& allocator)
+    : capacity(capacity), size(0), increase(increase), growth_factor(2.0), allocator(allocator), elements(allocate(capacity))
+{
+}
 
-    size_t thread_safe_capacity();
-    size_t no_thread_safe_capacity();
+template <typename T, typename Lock, typename Allocator>
+template <typename B, enable_if_bool<B>>
+Vector<T, Lock, Allocator>::Vector(B is_thread_safe, const Allocator& allocator)
+    : capacity(10), size(0), increase(capacity / 2), growth_factor(2.0), allocator(allocator), elements(allocate(capacity)), mutex(is_thread_safe)
+{
+}
 
-    int thread_safe_increase();
-    int no_thread_safe_increase();
-};
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(size_t capacity, bool is_thread_safe, const Allocator& allocator)
+    : capacity(capacity), size(0), increase(capacity / 2), growth_factor(2.0), allocator(allocator), elements(allocate(capacity)), mutex(is_thread_safe)
+{
+}
 
-template <typename T>
-Vector<T>::Vector(bool is_thread_safe)
-    : capacity(10), size(0), increase(capacity / 2), elements(new T[capacity])
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(size_t capacity, int increase, bool is_thread_safe, const Allocator& allocator)
+    : capacity(capacity), size(0), increase(increase), growth_factor(2.0), allocator(allocator), elements(allocate(capacity)), mutex(is_thread_safe)
 {
-    initialize_functions(is_thread_safe);
 }
 
-template <typename T>
-Vector<T>::Vector(size_t capacity, bool is_thread_safe)
-    : capacity(capacity), size(0), increase(capacity / 2), elements(new T[capacity])
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(const Vector& other)
+    : allocator(AllocatorTraits::select_on_container_copy_construction(other.allocator)), mutex(other.mutex)
 {
-    initialize_functions(is_thread_safe);
+    std::shared_lock<Lock> lock(other.mutex);
+
+    capacity      = other.capacity;
+    size          = 0;
+    increase      = other.increase;
+    growth_factor = other.growth_factor;
+    elements      = allocate(capacity);
+
+    DS_TRY
+    {
+        for (; size < other.size; ++size)
+            AllocatorTraits::construct(allocator, elements + size, other.elements[size]);
+    }
+    DS_CATCH_ALL
+    {
+        destroy_elements();
+        deallocate(elements, capacity);
+        DS_RETHROW;
+    }
 }
 
-template <typename T>
-Vector<T>::Vector(size_t capacity, int increase, bool is_thread_safe)
-    : capacity(capacity), size(0), increase(increase), elements(new T[capacity])
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::Vector(Vector&& other)
+    : allocator(other.allocator), mutex(other.mutex)
 {
-    initialize_functions(is_thread_safe);
+    std::lock_guard<Lock> lock(other.mutex);
+
+    steal(other);
 }
 
-template <typename T>
-Vector<T>::~Vector()
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>::~Vector()
 {
-    delete[] elements;
+    destroy_elements();
+    deallocate(elements, capacity);
 }
 
-template <typename T>
-void Vector<T>::initialize_functions(bool is_thread_safe)
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator>& Vector<T, Lock, Allocator>::operator=(Vector&& other)
 {
-    if (is_thread_safe)
+    if (this == &other)
+        return *this;
+
+    PairLockGuard<Lock> lock(mutex, other.mutex);
+
+    destroy_elements();
+
+    if (AllocatorTraits::propagate_on_container_move_assignment::value || allocator == other.allocator)
     {
-        push_back    = [this](const T& element) { this->thread_safe_push_back(element); };
-        pop          = [this]() { return this->thread_safe_pop(); };
-        at           = [this](int index) { return this->thread_safe_at(index); };
-        get_size     = [this]() { return this->thread_safe_size(); };
-        get_length   = [this]() { return this->thread_safe_length(); };
-        get_capacity = [this]() { return this->thread_safe_capacity(); };
+        deallocate(elements, capacity);
+
+        if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value)
+            allocator = std::move(other.allocator);
+
+        steal(other);
     }
     else
     {
-        push_back    = [this](const T& element) { this->no_thread_safe_push_back(element); };
-        pop          = [this]() { return this->no_thread_safe_pop(); };
-        at           = [this](int index) { return this->no_thread_safe_at(index); };
-        get_size     = [this]() { return this->no_thread_safe_size(); };
-        get_length   = [this]() { return this->no_thread_safe_length(); };
-        get_capacity = [this]() { return this->no_thread_safe_capacity(); };
+        // Our allocator cannot free other's buffer, so the elements move one
+        // by one into storage we own.
+        if (capacity < other.size)
+        {
+            deallocate(elements, capacity);
+            elements = nullptr;
+            capacity = 0;
+            elements = allocate(other.size);
+            capacity = other.size;
+        }
+
+        for (; size < other.size; ++size)
+            AllocatorTraits::construct(allocator, elements + size, std::move(other.elements[size]));
+
+        increase      = other.increase;
+        growth_factor = other.growth_factor;
+
+        other.destroy_elements();
     }
+
+    return *this;
+}
+
+// Swapping buffers is only possible when each allocator can free the
+// other's memory.
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::swap(Vector& other)
+{
+    if (this == &other)
+        return;
+
+    PairLockGuard<Lock> lock(mutex, other.mutex);
+
+    if constexpr (AllocatorTraits::propagate_on_container_swap::value)
+        std::swap(allocator, other.allocator);
+    else if (!(allocator == other.allocator))
+        DS_THROW(std::invalid_argument("Cannot swap containers with unequal allocators"));
+
+    std::swap(capacity, other.capacity);
+    std::swap(size, other.size);
+    std::swap(increase, other.increase);
+    std::swap(growth_factor, other.growth_factor);
+    std::swap(elements, other.elements);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::steal(Vector& other)
+{
+    capacity      = other.capacity;
+    size          = other.size;
+    increase      = other.increase;
+    growth_factor = other.growth_factor;
+    elements      = other.elements;
+
+    other.capacity = 0;
+    other.size     = 0;
+    other.elements = nullptr;
+}
+
+template <typename T, typename Lock, typename Allocator>
+Vector<T, Lock, Allocator> Vector<T, Lock, Allocator>::clone() const
+{
+    return Vector(*this);
 }
 
-template <typename T>
-bool Vector<T>::is_full()
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::destroy_elements()
 {
-    return (size + 1 == capacity);
+    for (size_t i = 0; i < size; ++i)
+        AllocatorTraits::destroy(allocator, elements + i);
+
+    size = 0;
 }
 
-template <typename T>
-bool Vector<T>::is_empty()
+template <typename T, typename Lock, typename Allocator>
+bool Vector<T, Lock, Allocator>::is_full() const
+{
+    return (size == capacity);
+}
+
+template <typename T, typename Lock, typename Allocator>
+bool Vector<T, Lock, Allocator>::is_empty() const
 {
     return (size == 0);
 }
 
-template <typename T>
-void Vector<T>::thread_safe_push_back(const T& element)
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::reserve(size_t new_capacity)
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<Lock> lock(mutex);
 
-    if (is_full())
-        increase_capacity();
+    if (new_capacity > capacity)
+        relocate(new_capacity);
+}
 
-    elements[size++] = element;
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::push_back(const T& element)
+{
+    emplace_back(element);
 }
 
-template <typename T>
-void Vector<T>::no_thread_safe_push_back(const T& element)
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::push_back(T&& element)
 {
+    emplace_back(std::move(element));
+}
+
+template <typename T, typename Lock, typename Allocator>
+template <typename... Args>
+void Vector<T, Lock, Allocator>::emplace_back(Args&&... args)
+{
+    std::lock_guard<Lock> lock(mutex);
+
     if (is_full())
-        increase_capacity();
+    {
+        // The arguments may refer into the buffer that is about to move.
+        T element(std::forward<Args>(args)...);
+        increase_capacity(size + 1);
+        AllocatorTraits::construct(allocator, elements + size, std::move(element));
+    }
+    else
+    {
+        AllocatorTraits::construct(allocator, elements + size, std::forward<Args>(args)...);
+    }
 
-    elements[size++] = element;
+    size++;
 }
 
-template <typename T>
-T Vector<T>::thread_safe_pop()
+// Takes the lock and grows the buffer once for the whole range. The range
+// must not point into this vector.
+template <typename T, typename Lock, typename Allocator>
+template <typename InputIt>
+void Vector<T, Lock, Allocator>::append(InputIt first, InputIt last)
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
 
-    if (is_empty())
-        throw std::out_of_range("Index out of range");
+    std::lock_guard<Lock> lock(mutex);
 
-    size--;
-    T popped_element = elements[size];
-    elements[size] = T();
+    if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+    {
+        size_t count = std::distance(first, last);
+
+        if (size + count > capacity)
+            increase_capacity(size + count);
+
+        if constexpr (std::is_pointer<InputIt>::value && std::is_trivially_copyable<T>::value &&
+                      std::is_same<std::remove_cv_t<std::remove_pointer_t<InputIt>>, T>::value)
+        {
+            if (count)
+                std::memcpy(elements + size, first, count * sizeof(T));
+
+            size += count;
+        }
+        else
+        {
+            for (; first != last; ++first, ++size)
+                AllocatorTraits::construct(allocator, elements + size, *first);
+        }
+    }
+    else
+    {
+        for (; first != last; ++first, ++size)
+        {
+            if (is_full())
+                increase_capacity(size + 1);
 
-    return popped_element;
+            AllocatorTraits::construct(allocator, elements + size, *first);
+        }
+    }
 }
 
-template <typename T>
-T Vector<T>::no_thread_safe_pop()
+template <typename T, typename Lock, typename Allocator>
+T Vector<T, Lock, Allocator>::pop()
 {
+    std::lock_guard<Lock> lock(mutex);
+
     if (is_empty())
-        throw std::out_of_range("Index out of range");
+        DS_THROW(std::out_of_range("Index out of range"));
 
     size--;
-    T popped_element = elements[size];
-    elements[size] = T();
+    T popped_element = std::move(elements[size]);
+    AllocatorTraits::destroy(allocator, elements + size);
 
     return popped_element;
 }
 
-template <typename T>
-T Vector<T>::thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+T Vector<T, Lock, Allocator>::at(int index) const
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_lock<Lock> lock(mutex);
 
     if (index >= 0 && index < size)
         return elements[index];
     else
-        throw std::out_of_range("Index out of range");
+        DS_THROW(std::out_of_range("Index out of range"));
 }
 
-template <typename T>
-T Vector<T>::no_thread_safe_at(int index)
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Vector<T, Lock, Allocator>::try_pop()
 {
+    std::lock_guard<Lock> lock(mutex);
+
+    if (is_empty())
+        return std::nullopt;
+
+    size--;
+    std::optional<T> popped_element(std::move(elements[size]));
+    AllocatorTraits::destroy(allocator, elements + size);
+
+    return popped_element;
+}
+
+template <typename T, typename Lock, typename Allocator>
+std::optional<T> Vector<T, Lock, Allocator>::try_at(int index) const
+{
+    std::shared_lock<Lock> lock(mutex);
+
     if (index >= 0 && index < size)
         return elements[index];
-    else
-        throw std::out_of_range("Index out of range");
+
+    return std::nullopt;
 }
 
-template <typename T>
-size_t Vector<T>::thread_safe_size()
+// Bulk scans over arithmetic elements. Each one takes the lock once and runs
+// the vectorized kernel from simd.h over the whole buffer.
+template <typename T, typename Lock, typename Allocator>
+T Vector<T, Lock, Allocator>::sum() const
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    static_assert(std::is_arithmetic<T>::value, "sum() requires an arithmetic T");
 
-    return size * sizeof(T);
+    std::shared_lock<Lock> lock(mutex);
+
+    return simd::sum(elements, size);
 }
 
-template <typename T>
-size_t Vector<T>::no_thread_safe_size()
+template <typename T, typename Lock, typename Allocator>
+T Vector<T, Lock, Allocator>::min() const
 {
-    return size * sizeof(T);
+    static_assert(std::is_arithmetic<T>::value, "min() requires an arithmetic T");
+
+    std::shared_lock<Lock> lock(mutex);
+
+    if (is_empty())
+        DS_THROW(std::out_of_range("Index out of range"));
+
+    return simd::min(elements, size);
 }
 
-template <typename T>
-size_t Vector<T>::thread_safe_capacity()
+template <typename T, typename Lock, typename Allocator>
+T Vector<T, Lock, Allocator>::max() const
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    static_assert(std::is_arithmetic<T>::value, "max() requires an arithmetic T");
 
-    return capacity;
+    std::shared_lock<Lock> lock(mutex);
+
+    if (is_empty())
+        DS_THROW(std::out_of_range("Index out of range"));
+
+    return simd::max(elements, size);
 }
 
-template <typename T>
-size_t Vector<T>::no_thread_safe_capacity()
+// Returns the index of the first match, or -1.
+template <typename T, typename Lock, typename Allocator>
+int Vector<T, Lock, Allocator>::find(const T& value) const
 {
-    return capacity;
+    static_assert(std::is_arithmetic<T>::value, "find() requires an arithmetic T");
+
+    std::shared_lock<Lock> lock(mutex);
+
+    size_t index = simd::find(elements, size, value);
+
+    return index == size ? -1 : static_cast<int>(index);
 }
 
-template <typename T>
-size_t Vector<T>::thread_safe_length()
+template <typename T, typename Lock, typename Allocator>
+size_t Vector<T, Lock, Allocator>::count(const T& value) const
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    static_assert(std::is_arithmetic<T>::value, "count() requires an arithmetic T");
 
-    return size;
+    std::shared_lock<Lock> lock(mutex);
+
+    return simd::count(elements, size, value);
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::fill(const T& value)
+{
+    static_assert(std::is_arithmetic<T>::value, "fill() requires an arithmetic T");
+
+    std::lock_guard<Lock> lock(mutex);
+
+    simd::fill(elements, size, value);
+}
+
+// Replaces every element with function(element) under one lock. The loop is
+// left to the compiler's vectorizer since function is arbitrary.
+template <typename T, typename Lock, typename Allocator>
+template <typename Function>
+void Vector<T, Lock, Allocator>::transform(Function function)
+{
+    std::lock_guard<Lock> lock(mutex);
+
+    T* data = elements;
+    for (size_t i = 0; i < size; ++i)
+        data[i] = function(data[i]);
+}
+
+// Runs function(data, length) on the raw buffer while holding the lock, for
+// algorithms such as those in parallel.h that need the contiguous storage.
+template <typename T, typename Lock, typename Allocator>
+template <typename Function>
+decltype(auto) Vector<T, Lock, Allocator>::access(Function function)
+{
+    std::lock_guard<Lock> lock(mutex);
+
+    return function(elements, size);
+}
+
+template <typename T, typename Lock, typename Allocator>
+template <typename Function>
+decltype(auto) Vector<T, Lock, Allocator>::access(Function function) const
+{
+    std::shared_lock<Lock> lock(mutex);
+
+    return function(static_cast<const T*>(elements), size);
 }
 
-template <typename T>
-size_t Vector<T>::no_thread_safe_length()
+template <typename T, typename Lock, typename Allocator>
+size_t Vector<T, Lock, Allocator>::get_size() const
 {
+    std::shared_lock<Lock> lock(mutex);
+
+    return size * sizeof(T);
+}
+
+template <typename T, typename Lock, typename Allocator>
+size_t Vector<T, Lock, Allocator>::get_capacity() const
+{
+    std::shared_lock<Lock> lock(mutex);
+
+    return capacity;
+}
+
+template <typename T, typename Lock, typename Allocator>
+size_t Vector<T, Lock, Allocator>::get_length() const
+{
+    std::shared_lock<Lock> lock(mutex);
+
     return size;
 }
 
-template <typename T>
-int Vector<T>::thread_safe_increase()
+template <typename T, typename Lock, typename Allocator>
+int Vector<T, Lock, Allocator>::get_increase() const
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_lock<Lock> lock(mutex);
 
     return increase;
 }
 
-template <typename T>
-int Vector<T>::no_thread_safe_increase()
+template <typename T, typename Lock, typename Allocator>
+double Vector<T, Lock, Allocator>::get_growth_factor() const
 {
-    return increase;
+    std::shared_lock<Lock> lock(mutex);
+
+    return growth_factor;
 }
 
-template <typename T>
-void Vector<T>::increase_capacity()
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::set_growth_factor(double factor)
 {
-    capacity += increase;
+    if (factor <= 1.0)
+        DS_THROW(std::invalid_argument("Growth factor must be greater than 1"));
 
-    T* buffer_elements = new T[capacity];
+    std::lock_guard<Lock> lock(mutex);
 
-    for (size_t i = 0; i < size; ++i)
-        buffer_elements[i] = elements[i];
+    growth_factor = factor;
+}
+
+// Grows geometrically so push_back is amortized O(1); increase is kept as the
+// minimum step for small capacities.
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::increase_capacity(size_t minimum_capacity)
+{
+    size_t new_capacity = static_cast<size_t>(capacity * growth_factor);
+
+    if (increase > 0 && new_capacity < capacity + increase)
+        new_capacity = capacity + increase;
+
+    if (new_capacity < minimum_capacity)
+        new_capacity = minimum_capacity;
+
+    relocate(new_capacity);
+}
+
+template <typename T, typename Lock, typename Allocator>
+T* Vector<T, Lock, Allocator>::allocate(size_t count)
+{
+    if constexpr (uses_malloc)
+    {
+        void* buffer = std::malloc(count * sizeof(T));
+
+        if (!buffer && count)
+            DS_THROW(std::bad_alloc());
+
+        return static_cast<T*>(buffer);
+    }
+    else
+    {
+        return count ? AllocatorTraits::allocate(allocator, count) : nullptr;
+    }
+}
+
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::deallocate(T* buffer, size_t count)
+{
+    if constexpr (uses_malloc)
+        std::free(buffer);
+    else if (buffer)
+        AllocatorTraits::deallocate(allocator, buffer, count);
+}
 
-    delete[] elements;
+template <typename T, typename Lock, typename Allocator>
+void Vector<T, Lock, Allocator>::relocate(size_t new_capacity)
+{
+    if constexpr (uses_malloc && std::is_trivially_copyable<T>::value)
+    {
+        void* buffer_elements = std::realloc(elements, new_capacity * sizeof(T));
+
+        if (!buffer_elements)
+            DS_THROW(std::bad_alloc());
+
+        elements = static_cast<T*>(buffer_elements);
+    }
+    else
+    {
+        T* buffer_elements = allocate(new_capacity);
+        size_t moved = 0;
+
+        DS_TRY
+        {
+            for (; moved < size; ++moved)
+                AllocatorTraits::construct(allocator, buffer_elements + moved, std::move_if_noexcept(elements[moved]));
+        }
+        DS_CATCH_ALL
+        {
+            for (size_t i = 0; i < moved; ++i)
+                AllocatorTraits::destroy(allocator, buffer_elements + i);
+
+            deallocate(buffer_elements, new_capacity);
+            DS_RETHROW;
+        }
 
-    elements = buffer_elements;
+        for (size_t i = 0; i < size; ++i)
+            AllocatorTraits::destroy(allocator, elements + i);
+
+        deallocate(elements, capacity);
+
+        elements = buffer_elements;
+    }
+
+    capacity = new_capacity;
+}
+
+template <typename T, typename Lock, typename Allocator>
+Allocator Vector<T, Lock, Allocator>::get_allocator() const
+{
+    return allocator;
+}
+
+template <typename T, typename Lock, typename Allocator>
+const T& Vector<T, Lock, Allocator>::operator[](int index) const
+{
+    std::shared_lock<Lock> lock(mutex);
+
+    if (index >= 0 && index < size)
+        return elements[index];
+    else
+        DS_THROW(std::out_of_range("Index out of range"));
 }
 
-template <typename T>
-const T& Vector<T>::operator[](int index) const
+namespace pmr
 {
-    return at(index);
+    template <typename T, typename Lock = RuntimeLock>
+    using Vector = ::Vector<T, Lock, std::pmr::polymorphic_allocator<T>>;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,233 @@
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "exceptions.h"
+
+// Chase-Lev work-stealing deque. One owner thread pushes and pops at the
+// bottom, LIFO; any number of thieves steal from the top, FIFO. The owner
+// only needs a compare-and-swap when it races a thief for the last element,
+// and thieves only need one to claim the element they read.
+//
+// The circular buffer doubles when full. Thieves may still be reading the
+// old buffer, so it is kept until the deque is destroyed; since each buffer
+// is half the size of the next, that costs at most as much again as the
+// current buffer.
+//
+// Thieves read an element before they know whether they won it, so elements
+// are stored in atomics and T must be trivially copyable: task pointers or
+// small handles.
+template <typename T>
+class WorkStealingDeque
+{
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque elements must be trivially copyable");
+
+	struct Array
+	{
+		size_t          capacity;
+		std::atomic<T>* slots;
+		Array*          previous;
+
+		Array(size_t capacity, Array* previous)
+			: capacity(capacity), slots(new std::atomic<T>[capacity]), previous(previous)
+		{
+		}
+
+		~Array()
+		{
+			delete[] slots;
+		}
+
+		T get(std::int64_t index) const
+		{
+			return slots[index & (capacity - 1)].load(std::memory_order_relaxed);
+		}
+
+		void put(std::int64_t index, const T& element)
+		{
+			slots[index & (capacity - 1)].store(element, std::memory_order_relaxed);
+		}
+	};
+
+	alignas(64) std::atomic<std::int64_t> top;
+	alignas(64) std::atomic<std::int64_t> bottom;
+	alignas(64) std::atomic<Array*> array;
+
+public:
+	explicit WorkStealingDeque(size_t capacity = 64);
+	~WorkStealingDeque();
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	// Owner thread only.
+	void push(const T& element);
+	T    pop();
+	bool try_pop(T& element);
+
+	// Any thread. Fails when the deque is empty or another thread took the
+	// top element first; a scheduler usually moves on to the next victim.
+	bool try_steal(T& element);
+
+	// Exact only while no operation is in flight.
+	size_t get_size() const;
+	size_t get_length() const;
+	size_t get_capacity() const;
+	bool   is_empty() const;
+
+private:
+	Array* grow(Array* old_array, std::int64_t bottom_index, std::int64_t top_index);
+};
+
+template <typename T>
+WorkStealingDeque<T>::WorkStealingDeque(size_t capacity)
+	: top(0), bottom(0)
+{
+	size_t rounded = 1;
+	while (rounded < capacity)
+		rounded *= 2;
+
+	array.store(new Array(rounded, nullptr), std::memory_order_relaxed);
+}
+
+template <typename T>
+WorkStealingDeque<T>::~WorkStealingDeque()
+{
+	Array* current = array.load(std::memory_order_relaxed);
+
+	while (current)
+	{
+		Array* previous = current->previous;
+		delete current;
+		current = previous;
+	}
+}
+
+template <typename T>
+void WorkStealingDeque<T>::push(const T& element)
+{
+	std::int64_t b = bottom.load(std::memory_order_relaxed);
+	std::int64_t t = top.load(std::memory_order_acquire);
+	Array*       a = array.load(std::memory_order_relaxed);
+
+	if (b - t > static_cast<std::int64_t>(a->capacity) - 1)
+		a = grow(a, b, t);
+
+	a->put(b, element);
+
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template <typename T>
+T WorkStealingDeque<T>::pop()
+{
+	T element;
+
+	if (!try_pop(element))
+		DS_THROW(std::out_of_range("Index out of range"));
+
+	return element;
+}
+
+// Reserves the bottom element by lowering bottom first; the fence orders
+// that against the read of top, so a thief either sees the reservation or
+// the owner sees the thief's claim. Only the last element is contended.
+template <typename T>
+bool WorkStealingDeque<T>::try_pop(T& element)
+{
+	std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	Array*       a = array.load(std::memory_order_relaxed);
+
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	std::int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	element = a->get(b);
+
+	if (t < b)
+		return true;
+
+	bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_relaxed);
+
+	return won;
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::try_steal(T& element)
+{
+	std::int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return false;
+
+	T candidate = array.load(std::memory_order_acquire)->get(t);
+
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return false;
+
+	element = candidate;
+
+	return true;
+}
+
+// Copies the live range into a buffer twice the size. The old buffer keeps
+// its contents, so a thief that loaded it before the switch still reads the
+// right element.
+template <typename T>
+typename WorkStealingDeque<T>::Array* WorkStealingDeque<T>::grow(Array* old_array, std::int64_t bottom_index, std::int64_t top_index)
+{
+	Array* new_array = new Array(old_array->capacity * 2, old_array);
+
+	for (std::int64_t i = top_index; i < bottom_index; i++)
+		new_array->put(i, old_array->get(i));
+
+	array.store(new_array, std::memory_order_release);
+
+	return new_array;
+}
+
+template <typename T>
+size_t WorkStealingDeque<T>::get_size() const
+{
+	return get_length() * sizeof(T);
+}
+
+template <typename T>
+size_t WorkStealingDeque<T>::get_length() const
+{
+	std::int64_t b = bottom.load(std::memory_order_relaxed);
+	std::int64_t t = top.load(std::memory_order_relaxed);
+
+	return b > t ? static_cast<size_t>(b - t) : 0;
+}
+
+template <typename T>
+size_t WorkStealingDeque<T>::get_capacity() const
+{
+	return array.load(std::memory_order_relaxed)->capacity;
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::is_empty() const
+{
+	return get_length() == 0;
+}
+
+#endif